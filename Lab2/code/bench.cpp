@@ -0,0 +1,402 @@
+/*
+ * Benchmark of class Set against std::set, sorted std::vector, and std::flat_set (when available)
+ *
+ * Usage: Lab2Bench [max_size]
+ * Sizes go from 10 up to max_size (default 100000) in steps of 10x,
+ * for different densities, overlaps, and pairs of sizes
+ * Values are ints, so sizes whose values would go past INT_MAX at the lowest density are refused
+ * Results are written to std::cout as CSV, one line per backend, operation, and configuration
+ * Configure with -DCMAKE_BUILD_TYPE=Release to get meaningful timings
+ */
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <version>
+
+#if defined(__cpp_lib_flat_set)
+#include <flat_set>
+#endif
+
+#include "set.h"
+
+/*****************************************************
+ * Allocation counting: replace global new/delete     *
+ ******************************************************/
+
+namespace {
+std::size_t allocations = 0;      // number of calls of operator new
+std::size_t allocated_bytes = 0;  // bytes requested from operator new
+}  // namespace
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    allocated_bytes += size;
+
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+/*****************************************************
+ * Backends: same operations on each container        *
+ ******************************************************/
+
+struct SetBackend {
+    using Container = Set;
+    static constexpr const char* name = "Set";
+
+    static Container build(const std::vector<int>& v) {
+        return Set{v};
+    }
+    static Container unite(const Container& a, const Container& b) {
+        return a + b;
+    }
+    static Container intersect(const Container& a, const Container& b) {
+        return a * b;
+    }
+    static Container subtract(const Container& a, const Container& b) {
+        return a - b;
+    }
+    static bool contains(const Container& a, int val) {
+        return a.is_member(val);
+    }
+    static bool subset(const Container& a, const Container& b) {
+        return a <= b;
+    }
+    static std::size_t size(const Container& a) {
+        return a.cardinality();
+    }
+};
+
+struct StdSetBackend {
+    using Container = std::set<int>;
+    static constexpr const char* name = "std::set";
+
+    static Container build(const std::vector<int>& v) {
+        return Container(v.begin(), v.end());
+    }
+    static Container unite(const Container& a, const Container& b) {
+        Container result{a};
+        result.insert(b.begin(), b.end());
+        return result;
+    }
+    static Container intersect(const Container& a, const Container& b) {
+        Container result;
+        std::ranges::set_intersection(a, b, std::inserter(result, result.end()));
+        return result;
+    }
+    static Container subtract(const Container& a, const Container& b) {
+        Container result;
+        std::ranges::set_difference(a, b, std::inserter(result, result.end()));
+        return result;
+    }
+    static bool contains(const Container& a, int val) {
+        return a.contains(val);
+    }
+    static bool subset(const Container& a, const Container& b) {
+        return std::ranges::includes(b, a);
+    }
+    static std::size_t size(const Container& a) {
+        return a.size();
+    }
+};
+
+struct SortedVectorBackend {
+    using Container = std::vector<int>;
+    static constexpr const char* name = "sorted std::vector";
+
+    static Container build(const std::vector<int>& v) {
+        return v;
+    }
+    static Container unite(const Container& a, const Container& b) {
+        Container result;
+        result.reserve(a.size() + b.size());
+        std::ranges::set_union(a, b, std::back_inserter(result));
+        return result;
+    }
+    static Container intersect(const Container& a, const Container& b) {
+        Container result;
+        result.reserve(std::min(a.size(), b.size()));
+        std::ranges::set_intersection(a, b, std::back_inserter(result));
+        return result;
+    }
+    static Container subtract(const Container& a, const Container& b) {
+        Container result;
+        result.reserve(a.size());
+        std::ranges::set_difference(a, b, std::back_inserter(result));
+        return result;
+    }
+    static bool contains(const Container& a, int val) {
+        return std::ranges::binary_search(a, val);
+    }
+    static bool subset(const Container& a, const Container& b) {
+        return std::ranges::includes(b, a);
+    }
+    static std::size_t size(const Container& a) {
+        return a.size();
+    }
+};
+
+#if defined(__cpp_lib_flat_set)
+struct FlatSetBackend {
+    using Container = std::flat_set<int>;
+    static constexpr const char* name = "std::flat_set";
+
+    static Container build(const std::vector<int>& v) {
+        return Container(std::sorted_unique, v);
+    }
+    static Container unite(const Container& a, const Container& b) {
+        return Container(std::sorted_unique, SortedVectorBackend::unite(to_vector(a), to_vector(b)));
+    }
+    static Container intersect(const Container& a, const Container& b) {
+        std::vector<int> result;
+        std::ranges::set_intersection(a, b, std::back_inserter(result));
+        return Container(std::sorted_unique, std::move(result));
+    }
+    static Container subtract(const Container& a, const Container& b) {
+        std::vector<int> result;
+        std::ranges::set_difference(a, b, std::back_inserter(result));
+        return Container(std::sorted_unique, std::move(result));
+    }
+    static bool contains(const Container& a, int val) {
+        return a.contains(val);
+    }
+    static bool subset(const Container& a, const Container& b) {
+        return std::ranges::includes(b, a);
+    }
+    static std::size_t size(const Container& a) {
+        return a.size();
+    }
+
+private:
+    static std::vector<int> to_vector(const Container& a) {
+        return std::vector<int>(a.begin(), a.end());
+    }
+};
+#endif
+
+/*****************************************************
+ * Test data                                          *
+ ******************************************************/
+
+/*
+ * One benchmark configuration: a pair of sorted vectors and how they were generated
+ */
+struct Config {
+    std::size_t n1;   // size of the first Set
+    std::size_t n2;   // size of the second Set
+    double density;   // fraction of the values in the range [0, n1/density) that are in the first Set
+    double overlap;   // fraction of the values of the second Set that also belong to the first Set
+    std::vector<int> A;
+    std::vector<int> B;
+};
+
+/*
+ * Draw n distinct values among the available values x in [0, universe) for which keep(x) is true
+ * Selection sampling: each value is picked with probability (values still needed) / (values left),
+ * so the result comes out sorted in one pass
+ */
+template <typename Pred>
+std::vector<int> sorted_sample(std::size_t n, std::size_t universe, std::size_t available, Pred keep,
+                               std::mt19937& rng) {
+    std::vector<int> result;
+    result.reserve(n);
+
+    for (std::size_t x = 0; x < universe && result.size() < n; ++x) {
+        if (!keep(static_cast<int>(x))) {
+            continue;
+        }
+        if (std::uniform_int_distribution<std::size_t>{0, available - 1}(rng) < n - result.size()) {
+            result.push_back(static_cast<int>(x));
+        }
+        --available;
+    }
+    return result;
+}
+
+/*
+ * Ranges of the values of a configuration: A is drawn from [0, universe), and the values of B
+ * that are not in A from [0, range)
+ */
+struct ValueRanges {
+    std::size_t shared;    // number of values of B that are also in A
+    std::size_t universe;
+    std::size_t range;
+};
+
+ValueRanges value_ranges(std::size_t n1, std::size_t n2, double density, double overlap) {
+    const auto universe = static_cast<std::size_t>(static_cast<double>(n1) / density);
+    const auto shared = std::min(n1, static_cast<std::size_t>(overlap * static_cast<double>(n2)));
+    const std::size_t others = n2 - shared;
+    const std::size_t range = std::max(universe, n1 + static_cast<std::size_t>(static_cast<double>(others) / density));
+    return {shared, universe, range};
+}
+
+/*
+ * Test whether all values of the configuration fit in an int
+ */
+bool fits_in_int(std::size_t n1, std::size_t n2, double density, double overlap) {
+    return value_ranges(n1, n2, density, overlap).range <= static_cast<std::size_t>(std::numeric_limits<int>::max());
+}
+
+/*
+ * Generate the configuration, fits_in_int must be true
+ */
+Config make_config(std::size_t n1, std::size_t n2, double density, double overlap, std::mt19937& rng) {
+    Config c{n1, n2, density, overlap, {}, {}};
+
+    const auto [shared, universe, range] = value_ranges(n1, n2, density, overlap);
+    c.A = sorted_sample(n1, universe, universe, [](int) { return true; }, rng);
+
+    // Values of B shared with A
+    std::vector<int> common;
+    std::ranges::sample(c.A, std::back_inserter(common), static_cast<std::ptrdiff_t>(shared), rng);
+
+    // Values of B not in A, drawn from the same range widened enough to hold them
+    const std::size_t others = n2 - shared;
+    const std::vector<int> distinct = sorted_sample(
+        others, range, range - n1, [&](int x) { return !std::ranges::binary_search(c.A, x); }, rng);
+
+    std::ranges::merge(common, distinct, std::back_inserter(c.B));
+    return c;
+}
+
+/*****************************************************
+ * Measurements                                       *
+ ******************************************************/
+
+std::size_t checksum = 0;  // keeps the results alive, so the operations are not optimized away
+
+/*
+ * Run op reps times and write one CSV line with its average cost
+ */
+template <typename Op>
+void measure(const char* backend, const char* operation, const Config& c, std::size_t reps, std::size_t elements,
+             Op op) {
+    const std::size_t allocations_before = allocations;
+    const std::size_t bytes_before = allocated_bytes;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < reps; ++i) {
+        checksum += op();
+    }
+
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    const auto per_op = [reps](std::size_t x) { return static_cast<double>(x) / static_cast<double>(reps); };
+    const double bytes_per_op = per_op(allocated_bytes - bytes_before);
+
+    std::cout << '"' << backend << "\"," << operation << ',' << c.n1 << ',' << c.n2 << ',' << c.density << ','
+              << c.overlap << ',' << reps << ',' << elapsed.count() / static_cast<double>(reps) << ','
+              << per_op(allocations - allocations_before) << ','
+              << (elements == 0 ? 0.0 : bytes_per_op / static_cast<double>(elements)) << '\n';
+}
+
+template <typename Backend>
+void run(const Config& c) {
+    using Container = typename Backend::Container;
+
+    // Aim at roughly the same amount of work for every size
+    const std::size_t reps = std::clamp<std::size_t>(1'000'000 / (c.n1 + c.n2), 1, 1000);
+    const std::size_t probes = std::min<std::size_t>(c.B.size(), 1000);  // is_member is O(n) for Set
+
+    measure(Backend::name, "build", c, reps, c.n1, [&] { return Backend::size(Backend::build(c.A)); });
+
+    const Container a = Backend::build(c.A);
+    const Container b = Backend::build(c.B);
+
+    measure(Backend::name, "copy", c, reps, c.n1, [&] { return Backend::size(Container{a}); });
+    measure(Backend::name, "union", c, reps, c.n1 + c.n2,
+            [&] { return Backend::size(Backend::unite(a, b)); });
+    measure(Backend::name, "intersection", c, reps, std::min(c.n1, c.n2),
+            [&] { return Backend::size(Backend::intersect(a, b)); });
+    measure(Backend::name, "difference", c, reps, c.n1,
+            [&] { return Backend::size(Backend::subtract(a, b)); });
+    measure(Backend::name, "subset", c, reps, 0,
+            [&] { return static_cast<std::size_t>(Backend::subset(b, a)); });
+    measure(Backend::name, "is_member", c, std::max<std::size_t>(1, reps / 10), 0, [&] {
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < probes; ++i) {
+            found += Backend::contains(a, c.B[i]);
+        }
+        return found;
+    });
+}
+
+/*
+ * Call f(n1, n2, density, overlap) for every configuration with sizes up to max_size
+ * Stop and return false as soon as f returns false
+ */
+template <typename F>
+bool for_each_config(std::size_t max_size, F f) {
+    for (std::size_t n = 10; n <= max_size; n *= 10) {
+        // Equal sizes and a skewed pair, where the second Set is 100 times smaller
+        for (std::size_t n2 : {n, std::max<std::size_t>(1, n / 100)}) {
+            for (double density : {1.0, 0.01}) {
+                for (double overlap : {0.1, 0.9}) {
+                    if (!f(n, n2, density, overlap)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const std::size_t max_size = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+
+    // Refuse sizes whose values would not fit in an int, before measuring anything
+    const bool valid = for_each_config(max_size, [](std::size_t n1, std::size_t n2, double density, double overlap) {
+        if (fits_in_int(n1, n2, density, overlap)) {
+            return true;
+        }
+        std::cerr << "Lab2Bench: the values for n1 = " << n1 << ", n2 = " << n2 << ", density = " << density
+                  << " do not fit in an int, use a smaller max_size\n";
+        return false;
+    });
+    if (!valid) {
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 rng{2023};
+
+    std::cout << "backend,operation,n1,n2,density,overlap,reps,ns_per_op,allocations_per_op,bytes_per_element\n";
+
+    for_each_config(max_size, [&rng](std::size_t n1, std::size_t n2, double density, double overlap) {
+        const Config c{make_config(n1, n2, density, overlap, rng)};
+
+        run<SetBackend>(c);
+        run<StdSetBackend>(c);
+        run<SortedVectorBackend>(c);
+#if defined(__cpp_lib_flat_set)
+        run<FlatSetBackend>(c);
+#endif
+        return true;
+    });
+
+    std::cerr << "checksum: " << checksum << '\n';
+}
@@ -0,0 +1,451 @@
+#include "external_set.h"
+
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <type_traits>
+
+namespace external_set {
+
+static_assert(std::is_trivially_copyable_v<value_type>, "values are stored in files as raw bytes");
+
+namespace {
+
+constexpr std::size_t read_error = std::numeric_limits<std::size_t>::max();
+
+/*
+ * Sequential reader of a sorted file of values, with read-ahead
+ * One thread per Reader fills the next buffer while the values of the current buffer are consumed
+ * Repeated values are skipped, and a value smaller than the previous one stops the reader with an error
+ */
+class Reader {
+public:
+    Reader(const std::string& path, std::size_t buffer_size)
+        : in{path, std::ios::binary}, current(std::max<std::size_t>(buffer_size, 1)), next(current.size()) {
+        if (!in) {
+            error = true;
+            return;
+        }
+        worker = std::thread{&Reader::read_ahead, this};
+        load();
+    }
+
+    ~Reader() {
+        {
+            std::lock_guard lock{m};
+            stop = true;
+        }
+        ready.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // The reader thread refers to this Reader
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    /*
+     * Test whether all values were read, or reading stopped on an error
+     */
+    bool done() const {
+        return pos == size;
+    }
+
+    bool failed() const {
+        return error;
+    }
+
+    /*
+     * Current value, done() must be false
+     */
+    value_type value() const {
+        return current[pos];
+    }
+
+    /*
+     * Move to the next value that is larger than the current one, done() must be false
+     */
+    void step() {
+        const value_type last = current[pos];
+
+        while (true) {
+            if (++pos == size) {
+                load();
+                if (done()) {
+                    return;
+                }
+            }
+            if (last < current[pos]) {
+                return;
+            }
+            if (current[pos] < last) {  // not sorted
+                error = true;
+                pos = size = 0;
+                return;
+            }
+        }
+    }
+
+    /*
+     * Move to the first value that is not less than val
+     */
+    void seek(value_type val) {
+        while (!done() && current[pos] < val) {
+            step();
+        }
+    }
+
+    /*
+     * Read the remaining values, so that values that are not sorted are reported by failed()
+     */
+    void drain() {
+        while (!done()) {
+            step();
+        }
+    }
+
+private:
+    /*
+     * Body of the reader thread: fill next whenever load() has taken it, until the end of the file
+     */
+    void read_ahead() {
+        while (true) {
+            {
+                std::unique_lock lock{m};
+                ready.wait(lock, [this] { return stop || !filled; });
+                if (stop) {
+                    return;
+                }
+            }
+
+            // load() does not touch next until filled is set
+            in.read(reinterpret_cast<char*>(next.data()), static_cast<std::streamsize>(next.size() * sizeof(value_type)));
+            const std::size_t bytes = in.bad() ? read_error : static_cast<std::size_t>(in.gcount());
+            const bool full = (bytes == next.size() * sizeof(value_type));  // next belongs to load() once filled
+
+            {
+                std::lock_guard lock{m};
+                next_bytes = bytes;
+                filled = true;
+            }
+            ready.notify_all();
+
+            // A short read means the end of the file was reached
+            if (!full) {
+                return;
+            }
+        }
+    }
+
+    /*
+     * Wait for the buffer filled by the reader thread, make it the current buffer,
+     * and let the thread fill the other one
+     */
+    void load() {
+        pos = size = 0;
+        if (at_end) {
+            return;
+        }
+
+        std::size_t bytes;
+        {
+            std::unique_lock lock{m};
+            ready.wait(lock, [this] { return filled; });
+            bytes = next_bytes;
+            std::swap(current, next);
+            filled = false;
+        }
+        ready.notify_all();
+
+        at_end = (bytes != current.size() * sizeof(value_type));
+        if (bytes == read_error || bytes % sizeof(value_type) != 0) {
+            error = at_end = true;
+            return;
+        }
+        size = bytes / sizeof(value_type);
+    }
+
+    std::ifstream in;
+    std::vector<value_type> current;  // values being merged
+    std::vector<value_type> next;     // values being read by the reader thread
+    std::size_t pos = 0;              // position of the current value in current
+    std::size_t size = 0;             // number of values in current
+    bool error = false;
+    bool at_end = false;              // the last buffer was loaded
+
+    std::mutex m;                     // guards filled, next_bytes, and stop
+    std::condition_variable ready;
+    bool filled = false;              // next holds next_bytes bytes read by the thread
+    std::size_t next_bytes = 0;
+    bool stop = false;
+    std::thread worker;               // fills next, joined by the destructor
+};
+
+/*
+ * Sequential writer of a file of values, through one buffer
+ * The values go to a temporary file next to path, which replaces path only when finish() succeeds,
+ * so a failed operation never leaves a partial file behind
+ */
+class Writer {
+public:
+    Writer(const std::string& path, std::size_t buffer_size)
+        : target{path}, temporary{path + ".partial"}, out{temporary, std::ios::binary | std::ios::trunc},
+          capacity{std::max<std::size_t>(buffer_size, 1)} {
+        buffer.reserve(capacity);
+    }
+
+    ~Writer() {
+        if (!finished) {
+            discard();
+        }
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool good() const {
+        return out.good();
+    }
+
+    void push(value_type val) {
+        buffer.push_back(val);
+        ++count;
+        if (buffer.size() == capacity) {
+            flush();
+        }
+    }
+
+    /*
+     * Write the buffered values, close the file, and move it to path
+     * Return the number of values written, or std::nullopt if writing failed
+     */
+    std::optional<std::uint64_t> finish() {
+        flush();
+        out.close();
+        if (out.fail()) {
+            discard();
+            return std::nullopt;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, target, error);
+        if (error) {
+            discard();
+            return std::nullopt;
+        }
+        finished = true;
+        return count;
+    }
+
+    /*
+     * Close and remove the temporary file, path is left as it was
+     */
+    void discard() {
+        out.close();
+        std::error_code error;
+        std::filesystem::remove(temporary, error);
+        finished = true;
+    }
+
+private:
+    void flush() {
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(value_type)));
+        buffer.clear();
+    }
+
+    std::string target;     // path of the result
+    std::string temporary;  // path of the file being written
+    std::ofstream out;
+    std::vector<value_type> buffer;
+    std::size_t capacity;
+    std::uint64_t count = 0;
+    bool finished = false;  // the file was moved to target or removed
+};
+
+/*
+ * Open a Reader for each file in paths
+ * Return false if a file cannot be opened or read
+ */
+bool open(std::span<const std::string> paths, std::size_t buffer_size, std::deque<Reader>& readers) {
+    for (const auto& path : paths) {
+        if (readers.emplace_back(path, buffer_size).failed()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Finish writing the result, unless one of the readers failed, then the result is discarded
+ * Readers that stopped early are read to the end first, so that values that are not sorted are reported
+ */
+std::optional<std::uint64_t> finish(std::deque<Reader>& readers, Writer& out) {
+    for (auto& r : readers) {
+        r.drain();
+    }
+    if (std::ranges::any_of(readers, &Reader::failed)) {
+        out.discard();
+        return std::nullopt;
+    }
+    return out.finish();
+}
+
+}  // namespace
+
+/*
+ * Write the union of the files in inputs to output, in one k-way merge pass
+ */
+std::optional<std::uint64_t> union_files(std::span<const std::string> inputs, const std::string& output,
+                                         std::size_t buffer_size) {
+    using Entry = std::pair<value_type, std::size_t>;  // (value, index of its reader in readers)
+
+    std::deque<Reader> readers;
+    if (!open(inputs, buffer_size, readers)) {
+        return std::nullopt;
+    }
+    Writer out{output, buffer_size};
+    if (!out.good()) {
+        return std::nullopt;
+    }
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        if (!readers[i].done()) {
+            heap.emplace(readers[i].value(), i);
+        }
+    }
+
+    bool first = true;
+    value_type last{};
+    while (!heap.empty()) {
+        const auto [val, i] = heap.top();
+        heap.pop();
+
+        // Equal values leave the heap one after the other, keep only the first
+        if (first || last != val) {
+            out.push(val);
+            last = val;
+            first = false;
+        }
+
+        readers[i].step();
+        if (!readers[i].done()) {
+            heap.emplace(readers[i].value(), i);
+        }
+    }
+    return finish(readers, out);
+}
+
+/*
+ * Write the intersection of the files in inputs to output
+ * Every reader in turn skips to the largest current value, which is written once all readers reach it
+ */
+std::optional<std::uint64_t> intersection_files(std::span<const std::string> inputs, const std::string& output,
+                                                std::size_t buffer_size) {
+    std::deque<Reader> readers;
+    if (!open(inputs, buffer_size, readers)) {
+        return std::nullopt;
+    }
+    Writer out{output, buffer_size};
+    if (!out.good()) {
+        return std::nullopt;
+    }
+
+    const auto any_done = [&readers] { return std::ranges::any_of(readers, &Reader::done); };
+
+    while (!readers.empty() && !any_done()) {
+        const value_type target = std::ranges::max_element(readers, {}, &Reader::value)->value();
+
+        bool match = true;
+        for (auto& r : readers) {
+            r.seek(target);
+            if (r.done() || r.value() != target) {
+                match = false;
+            }
+        }
+
+        if (match) {
+            out.push(target);
+            for (auto& r : readers) {
+                r.step();
+            }
+        }
+    }
+    return finish(readers, out);
+}
+
+/*
+ * Write the values of file first that do not belong to any of the files in others to output
+ */
+std::optional<std::uint64_t> difference_files(const std::string& first, std::span<const std::string> others,
+                                              const std::string& output, std::size_t buffer_size) {
+    std::deque<Reader> readers;
+    if (!open(std::span{&first, 1}, buffer_size, readers) || !open(others, buffer_size, readers)) {
+        return std::nullopt;
+    }
+    Writer out{output, buffer_size};
+    if (!out.good()) {
+        return std::nullopt;
+    }
+
+    Reader& A = readers.front();
+    while (!A.done()) {
+        const value_type val = A.value();
+
+        bool found = false;
+        for (auto it = std::next(readers.begin()); it != readers.end(); ++it) {
+            it->seek(val);
+            found = found || (!it->done() && it->value() == val);
+        }
+
+        if (!found) {
+            out.push(val);
+        }
+        A.step();
+    }
+    return finish(readers, out);
+}
+
+/*
+ * Write the values of S to file output
+ */
+bool write_file(const Set& S, const std::string& output) {
+    Writer out{output, default_buffer_size};
+
+    for (value_type val : S) {
+        out.push(val);
+    }
+    return out.finish().has_value();
+}
+
+/*
+ * Read a Set from file input
+ */
+std::optional<Set> read_file(const std::string& input, std::size_t buffer_size) {
+    Reader in{input, buffer_size};
+    Set result{};
+
+    // Values come in increasing order, so each one is appended in O(1)
+    while (!in.done()) {
+        result.insert(in.value());
+        in.step();
+    }
+
+    if (in.failed()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+}  // namespace external_set
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+#include "set.h"
+
+/** Set operations on sorted files of values, for sets that do not fit in memory
+ *
+ * A file holds values of type Set::value_type in increasing order, stored as raw bytes in native byte order
+ * Repeated values are allowed in the input files and are written once, as in a Set
+ *
+ * The operations have the same merge semantics as Set::operator+=, *=, and -=
+ * Every input file is read sequentially through two buffers of buffer_size values:
+ * one reader thread per file reads the next block while the current block is merged
+ * The result is written sequentially to a new file through one more buffer,
+ * so memory use is (2 * number of input files + 1) * buffer_size values, whatever the size of the files
+ *
+ * Each operation returns the number of values written to output, or std::nullopt if a file cannot be
+ * read or written, its size is not a multiple of the size of a value, or its values are not sorted
+ * The result is written to output + ".partial" and renamed to output on success,
+ * so on failure output is left as it was and no partial file remains
+ * The output file must not be one of the input files
+ */
+namespace external_set {
+
+using value_type = Set::value_type;
+
+inline constexpr std::size_t default_buffer_size = std::size_t{1} << 16;  // values per buffer
+
+/*
+ * Write the union of the files in inputs to output, in one k-way merge pass
+ */
+std::optional<std::uint64_t> union_files(std::span<const std::string> inputs, const std::string& output,
+                                         std::size_t buffer_size = default_buffer_size);
+
+/*
+ * Write the intersection of the files in inputs to output
+ * Merging stops as soon as one of the files ends, the rest of the other files is only checked
+ */
+std::optional<std::uint64_t> intersection_files(std::span<const std::string> inputs, const std::string& output,
+                                                std::size_t buffer_size = default_buffer_size);
+
+/*
+ * Write the values of file first that do not belong to any of the files in others to output
+ * Merging stops as soon as first ends, the rest of the other files is only checked
+ */
+std::optional<std::uint64_t> difference_files(const std::string& first, std::span<const std::string> others,
+                                              const std::string& output,
+                                              std::size_t buffer_size = default_buffer_size);
+
+/*
+ * Write the values of S to file output
+ * Return false if the file cannot be written
+ */
+bool write_file(const Set& S, const std::string& output);
+
+/*
+ * Read a Set from file input
+ * Return std::nullopt if the file cannot be read, or its values are not sorted
+ */
+std::optional<Set> read_file(const std::string& input, std::size_t buffer_size = default_buffer_size);
+
+}  // namespace external_set
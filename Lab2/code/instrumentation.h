@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+/** Instrumentation of class Set
+ *
+ * Built with SET_INSTRUMENTATION defined (CMake option SET_INSTRUMENTATION, ON by default),
+ * Set keeps track of its nodes, memory, and the work done by its merge operations
+ * All counters are atomic, so Sets can be used from several threads
+ *
+ * Built without SET_INSTRUMENTATION, every hook below is an empty inline function
+ * and all counters read as zero, so the instrumentation costs nothing
+ */
+namespace set_instrumentation {
+
+/*
+ * Set operations that are measured
+ */
+enum class Operation { set_union, set_intersection, set_difference, comparison, count };
+
+/*
+ * Statistics for one kind of Operation
+ */
+struct OperationStats {
+    long long calls = 0;        // number of times the operation was called
+    long long merge_steps = 0;  // number of iterations of the merge loops
+    long long time_ns = 0;      // total time spent in the operation, in nanoseconds
+};
+
+/*
+ * Snapshot of all counters
+ */
+struct Stats {
+    long long live_nodes = 0;   // number of existing nodes
+    long long peak_nodes = 0;   // largest number of nodes that existed at the same time
+    long long allocations = 0;  // number of node allocations
+    long long heap_allocations = 0;  // number of node allocations not served by the cache of freed nodes
+    long long live_bytes = 0;   // bytes currently allocated for nodes
+    OperationStats operations[static_cast<std::size_t>(Operation::count)];
+
+    const OperationStats& operator[](Operation op) const {
+        return operations[static_cast<std::size_t>(op)];
+    }
+};
+
+#ifdef SET_INSTRUMENTATION
+
+inline constexpr bool enabled = true;
+
+struct Counters {
+    std::atomic<long long> live_nodes{0};
+    std::atomic<long long> peak_nodes{0};
+    std::atomic<long long> allocations{0};
+    std::atomic<long long> heap_allocations{0};
+    std::atomic<long long> live_bytes{0};
+
+    struct {
+        std::atomic<long long> calls{0};
+        std::atomic<long long> merge_steps{0};
+        std::atomic<long long> time_ns{0};
+    } operations[static_cast<std::size_t>(Operation::count)];
+};
+
+inline Counters counters;
+
+inline void node_created() {
+    const long long live = counters.live_nodes.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    long long peak = counters.peak_nodes.load(std::memory_order_relaxed);
+    while (peak < live && !counters.peak_nodes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+inline void node_destroyed() {
+    counters.live_nodes.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void allocated(std::size_t bytes) {
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.live_bytes.fetch_add(static_cast<long long>(bytes), std::memory_order_relaxed);
+}
+
+inline void deallocated(std::size_t bytes) {
+    counters.live_bytes.fetch_sub(static_cast<long long>(bytes), std::memory_order_relaxed);
+}
+
+inline void heap_allocated() {
+    counters.heap_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline long long live_nodes() {
+    return counters.live_nodes.load(std::memory_order_relaxed);
+}
+
+/*
+ * Measure one call of a Set operation: create it when the operation starts,
+ * call step() once per iteration of the merge loop,
+ * and the destructor records the steps and the elapsed time
+ */
+class ScopedOperation {
+public:
+    explicit ScopedOperation(Operation op) : kind{op}, start{std::chrono::steady_clock::now()} {
+    }
+
+    ~ScopedOperation() {
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        auto& stats = counters.operations[static_cast<std::size_t>(kind)];
+
+        stats.calls.fetch_add(1, std::memory_order_relaxed);
+        stats.merge_steps.fetch_add(steps, std::memory_order_relaxed);
+        stats.time_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                std::memory_order_relaxed);
+    }
+
+    ScopedOperation(const ScopedOperation&) = delete;
+    ScopedOperation& operator=(const ScopedOperation&) = delete;
+
+    void step() {
+        ++steps;
+    }
+
+private:
+    Operation kind;
+    std::chrono::steady_clock::time_point start;
+    long long steps = 0;
+};
+
+inline Stats snapshot() {
+    Stats s{};
+    s.live_nodes = counters.live_nodes.load(std::memory_order_relaxed);
+    s.peak_nodes = counters.peak_nodes.load(std::memory_order_relaxed);
+    s.allocations = counters.allocations.load(std::memory_order_relaxed);
+    s.heap_allocations = counters.heap_allocations.load(std::memory_order_relaxed);
+    s.live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+
+    for (std::size_t i = 0; i < static_cast<std::size_t>(Operation::count); ++i) {
+        s.operations[i].calls = counters.operations[i].calls.load(std::memory_order_relaxed);
+        s.operations[i].merge_steps = counters.operations[i].merge_steps.load(std::memory_order_relaxed);
+        s.operations[i].time_ns = counters.operations[i].time_ns.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+/*
+ * Reset all counters, except the number of existing nodes and bytes
+ * The peak restarts from the current number of nodes
+ */
+inline void reset() {
+    counters.peak_nodes.store(counters.live_nodes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    counters.allocations.store(0, std::memory_order_relaxed);
+    counters.heap_allocations.store(0, std::memory_order_relaxed);
+
+    for (auto& op : counters.operations) {
+        op.calls.store(0, std::memory_order_relaxed);
+        op.merge_steps.store(0, std::memory_order_relaxed);
+        op.time_ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+#else
+
+inline constexpr bool enabled = false;
+
+inline void node_created() {
+}
+
+inline void node_destroyed() {
+}
+
+inline void allocated(std::size_t) {
+}
+
+inline void deallocated(std::size_t) {
+}
+
+inline void heap_allocated() {
+}
+
+inline long long live_nodes() {
+    return 0;
+}
+
+class ScopedOperation {
+public:
+    explicit ScopedOperation(Operation) {
+    }
+
+    void step() {
+    }
+};
+
+inline Stats snapshot() {
+    return Stats{};
+}
+
+inline void reset() {
+}
+
+#endif
+
+}  // namespace set_instrumentation
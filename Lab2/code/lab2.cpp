@@ -2,8 +2,26 @@
 #include <iomanip>
 #include <sstream>
 #include <cassert>
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+#include <limits>
+#include <cstdint>
+#include <numeric>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
 
 #include "set.h"
+#include "query.h"
+#include "external_set.h"
+
+// The tests check the number of existing nodes
+#ifndef SET_INSTRUMENTATION
+#error "lab2.cpp requires SET_INSTRUMENTATION, configure with -DSET_INSTRUMENTATION=ON"
+#endif
 
 int main() {
     /*****************************************************
@@ -133,6 +151,9 @@ int main() {
         assert(S1.is_member(3));
         assert(S1.is_member(5));
         assert(S1.is_member(99999) == false);
+        assert(S1.is_member(0) == false);
+        assert(S1.is_member(4) == false);
+        assert(Set{}.is_member(1) == false);
     }
 
     assert(Set::get_count_nodes() == 0);
@@ -187,6 +208,11 @@ int main() {
         std::vector<int> A4{10};  // singleton
         assert(Set{A4} == 10);
         assert(10 == Set{A4});
+
+        std::vector<int> A5{2, 5};
+        std::vector<int> A6{1, 2, 3};
+        assert((Set{A5} <=> Set{A6}) == std::partial_ordering::unordered);
+        assert((Set{A6} <=> Set{A5}) == std::partial_ordering::unordered);
     }
 
     assert(Set::get_count_nodes() == 0);
@@ -211,6 +237,10 @@ int main() {
         S2 *= S2;
         assert(Set::get_count_nodes() == 13);
 
+        S2 += S2;
+        assert(Set::get_count_nodes() == 13);
+        assert(S2 == Set{A2});
+
         // Test
         std::vector<int> A3{1, 2, 3, 5, 7, 8};
         assert(S1 == Set{A3});
@@ -257,6 +287,12 @@ int main() {
         // test
         std::vector<int> A5{1, 5, 8};
         assert(S3 == Set{A5});
+
+        // Sets with non-overlapping ranges
+        std::vector<int> A6{20, 30};
+        assert((S1 * Set{A6}).is_empty());
+        assert((Set{A6} * S1).is_empty());
+        assert((S1 - Set{A6}) == S1);
     }
 
     assert(Set::get_count_nodes() == 0);
@@ -299,6 +335,707 @@ int main() {
         assert(S2 == Set{A2});
     }
 
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 10                                      *
+     * insert, erase, and constructor from unsorted data  *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 10: insert and erase\n";
+
+    {
+        std::vector<int> A1{5, 1, 3, 1, 5};
+        Set S1{A1};
+        assert(Set::get_count_nodes() == 5);
+
+        // Test
+        assert(S1 == Set(std::vector<int>{1, 3, 5}));
+
+        assert(S1.insert(4));
+        assert(S1.insert(4) == false);
+        assert(S1.insert(9));
+        assert(S1.insert(-2));
+        assert(Set::get_count_nodes() == 8);
+
+        assert(S1.erase(3));
+        assert(S1.erase(3) == false);
+        assert(S1.erase(100) == false);
+        assert(Set::get_count_nodes() == 7);
+
+        std::vector<int> A2{7, 0, 9, 7, 2, 1};
+        assert(S1.insert(A2) == 3);
+        assert(Set::get_count_nodes() == 10);
+
+        // Test
+        std::ostringstream os{};
+        os << S1;
+
+        std::string tmp{os.str()};
+        assert((tmp == std::string{"{ -2 0 1 2 4 5 7 9 }"}));
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 11                                      *
+     * Iterators: begin, end, and lower_bound             *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 11: iterators\n";
+
+    {
+        static_assert(std::bidirectional_iterator<Set::const_iterator>);
+        static_assert(std::ranges::bidirectional_range<Set>);
+
+        std::vector<int> A1{1, 3, 5, 8};
+        Set S1{A1};
+        Set S2{};
+
+        // Test
+        assert(std::ranges::equal(S1, A1));
+        assert(std::ranges::equal(S1 | std::views::reverse, A1 | std::views::reverse));
+        assert(S2.begin() == S2.end());
+        assert(std::ranges::distance(S1) == 4);
+
+        std::vector<int> A2(S1.begin(), S1.end());
+        assert(A2 == A1);
+
+        assert(*S1.lower_bound(3) == 3);
+        assert(*S1.lower_bound(4) == 5);
+        assert(*S1.lower_bound(-10) == 1);
+        assert(S1.lower_bound(9) == S1.end());
+        assert(*std::prev(S1.end()) == 8);
+
+        assert(Set::get_count_nodes() == 8);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 12                                      *
+     * union_all and intersect_all                        *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 12: union_all and intersect_all\n";
+
+    {
+        Set S1{std::vector<int>{1, 3, 5, 7, 9}};
+        Set S2{std::vector<int>{3, 4, 5, 9}};
+        Set S3{std::vector<int>{0, 3, 9, 12}};
+
+        std::vector<const Set*> all{&S1, &S2, &S3};
+
+        Set S4{Set::union_all(all)};
+        assert(S4 == Set(std::vector<int>{0, 1, 3, 4, 5, 7, 9, 12}));
+
+        Set S5{Set::intersect_all(all)};
+        assert(S5 == Set(std::vector<int>{3, 9}));
+
+        // Same results as folding the Sets pairwise
+        assert(S4 == S1 + S2 + S3);
+        assert(S5 == S1 * S2 * S3);
+
+        assert(Set::union_all({}).is_empty());
+        assert(Set::intersect_all({}).is_empty());
+
+        std::vector<const Set*> one{&S2};
+        assert(Set::union_all(one) == S2);
+        assert(Set::intersect_all(one) == S2);
+
+        assert(Set::get_count_nodes() == 33);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 13                                      *
+     * Move constructor and move assignment               *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 13: move constructor and move assignment\n";
+
+    {
+        std::vector<int> A1{1, 2, 3};
+
+        Set S1{A1};
+        Set S2{std::move(S1)};
+        assert(Set::get_count_nodes() == 7);
+
+        // Test
+        assert(S1.is_empty());
+        assert(S2 == Set{A1});
+
+        S1 = std::move(S2);
+        assert(Set::get_count_nodes() == 7);
+
+        // Test
+        assert(S2.is_empty());
+        assert(S1 == Set{A1});
+
+        Set S3{S1 + 4};
+        assert(Set::get_count_nodes() == 13);
+
+        // Test
+        A1.push_back(4);
+        assert(S3 == Set{A1});
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 14                                      *
+     * Count-only set algebra and jaccard                 *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 14: intersection_size, union_size, difference_size, and jaccard\n";
+
+    {
+        std::vector<int> A1{1, 3, 5, 8};
+        std::vector<int> A2{2, 3, 7, 8};
+
+        Set S1{A1};
+        Set S2{A2};
+        Set S3{};
+        assert(Set::get_count_nodes() == 14);
+
+        // Test
+        assert(S1.intersection_size(S2) == (S1 * S2).cardinality());
+        assert(S1.union_size(S2) == (S1 + S2).cardinality());
+        assert(S1.difference_size(S2) == (S1 - S2).cardinality());
+        assert(S2.difference_size(S1) == (S2 - S1).cardinality());
+        assert(S1.intersection_size(S1) == 4);
+        assert(S1.intersection_size(S3) == 0);
+        assert(S1.union_size(S3) == 4);
+
+        assert(S1.jaccard(S2) == 2.0 / 6.0);
+        assert(S1.jaccard(S1) == 1.0);
+        assert(S1.jaccard(S3) == 0.0);
+        assert(S3.jaccard(S3) == 1.0);
+
+        assert(Set::get_count_nodes() == 14);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 15                                      *
+     * write_binary and read_binary                       *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 15: binary format\n";
+
+    {
+        std::vector<int> A1{std::numeric_limits<int>::min(), -7};
+        for (int i = 0; i < 1000; ++i) {
+            A1.push_back(3 * i);
+        }
+        A1.push_back(std::numeric_limits<int>::max());
+
+        Set S1{A1};
+        Set S2{};
+
+        std::stringstream ss{std::ios::in | std::ios::out | std::ios::binary};
+        S1.write_binary(ss);
+        S2.write_binary(ss);
+        S1.write_binary(ss);
+
+        // Test
+        Set S3{Set::read_binary(ss)};
+        assert(ss && S3 == S1);
+
+        Set S4{Set::read_binary(ss)};
+        assert(ss && S4.is_empty());
+
+        // Only the blocks with values in [400, 500] are decoded
+        Set S5{Set::read_binary(ss, 400, 500)};
+        assert(ss);
+
+        std::vector<int> A2{};
+        for (int i = 402; i <= 500; i += 3) {
+            A2.push_back(i);
+        }
+        assert(S5 == Set{A2});
+
+        // The stream is at the end of the data
+        assert(ss.peek() == std::stringstream::traits_type::eof());
+
+        std::stringstream bad{"not a set", std::ios::in | std::ios::binary};
+        assert(Set::read_binary(bad).is_empty());
+        assert(bad.fail());
+
+        // Hand-made data: magic, number of values, number of blocks, index of (first value, bytes), blocks
+        const auto varint = [](std::uint64_t x) {
+            std::string bytes;
+            for (; x >= 0x80; x >>= 7) {
+                bytes.push_back(static_cast<char>((x & 0x7F) | 0x80));
+            }
+            bytes.push_back(static_cast<char>(x));
+            return bytes;
+        };
+        [[maybe_unused]] const auto zigzag = [](std::int64_t v) {
+            return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+        };
+        [[maybe_unused]] const auto header = [&varint](std::uint64_t n, std::uint64_t n_blocks) {
+            return "TSET" + varint(n) + varint(n_blocks);
+        };
+        [[maybe_unused]] const auto read_fails = [](const std::string& data) {
+            std::stringstream is{data, std::ios::in | std::ios::binary};
+            Set S{Set::read_binary(is)};
+            return is.fail();
+        };
+        [[maybe_unused]] const auto read_range_fails = [](const std::string& data, int lo, int hi) {
+            std::stringstream is{data, std::ios::in | std::ios::binary};
+            Set S{Set::read_binary(is, lo, hi)};
+            return is.fail();
+        };
+
+        [[maybe_unused]] const int int_max = std::numeric_limits<int>::max();
+        std::string ones(127, '\x01');  // 127 deltas of 1
+
+        // Test
+        assert(!read_fails(header(2, 1) + varint(zigzag(5)) + varint(1) + varint(1)));
+
+        // val + delta overflows
+        assert(read_fails(header(2, 1) + varint(zigzag(int_max)) + varint(1) + varint(1)));
+
+        // First value of a block out of range, or not increasing
+        assert(read_fails(header(1, 1) + varint(zigzag(int_max + 1LL)) + varint(0)));
+        assert(read_fails(header(129, 2) + varint(zigzag(0)) + varint(127) + varint(zigzag(0)) + varint(0) + ones));
+
+        // First value of a block not greater than the last value of the previous block
+        assert(read_fails(header(129, 2) + varint(zigzag(0)) + varint(127) + varint(zigzag(100)) + varint(0) + ones));
+        assert(!read_fails(header(129, 2) + varint(zigzag(0)) + varint(127) + varint(zigzag(128)) + varint(0) + ones));
+
+        // Size of a block in the index differs from the bytes of the block
+        assert(read_fails(header(2, 1) + varint(zigzag(5)) + varint(2) + varint(1) + varint(1)));
+
+        // Number of blocks does not match the number of values
+        assert(read_fails(header(2, 2) + varint(zigzag(5)) + varint(1) + varint(zigzag(9)) + varint(0) + varint(1)));
+        assert(read_fails(header(0, 1) + varint(zigzag(5)) + varint(0)));
+        assert(read_fails(header(200, 1) + varint(zigzag(5)) + varint(127) + ones));
+
+        // Sizes of skipped blocks that are not valid stream offsets, or go past the end of the data
+        const std::string two_blocks = header(129, 2) + varint(zigzag(0));
+        assert(!read_range_fails(two_blocks + varint(127) + varint(zigzag(128)) + varint(0) + ones, 200, 300));
+        assert(read_range_fails(two_blocks + varint(std::uint64_t{1} << 63) + varint(zigzag(128)) + varint(0) + ones,
+                                200, 300));
+        assert(read_range_fails(two_blocks + varint(std::numeric_limits<std::int64_t>::max()) + varint(zigzag(128)) +
+                                    varint(2) + ones, 200, 300));
+        assert(read_range_fails(two_blocks + varint(1000) + varint(zigzag(128)) + varint(0) + ones, 200, 300));
+        assert(read_range_fails(two_blocks + varint(127) + varint(zigzag(128)) + varint(1000) + ones, 0, 10));
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 16                                      *
+     * Instrumentation: get_stats and reset_stats         *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 16: instrumentation\n";
+
+    {
+        using set_instrumentation::Operation;
+
+        Set S1{std::vector<int>{1, 3, 5, 8}};
+        Set S2{std::vector<int>{2, 3, 7}};
+        Set::reset_stats();
+
+        S1 += S2;
+        S1 -= S2;
+
+        [[maybe_unused]] Set::Stats stats{Set::get_stats()};
+
+        // Test
+        assert(stats.live_nodes == Set::get_count_nodes());
+        assert(stats.live_nodes == 10);
+        assert(stats.peak_nodes == 13);
+        assert(stats.allocations == 2);
+        assert(stats.live_bytes > 0);
+        assert(stats[Operation::set_union].calls == 1);
+        assert(stats[Operation::set_union].merge_steps == 5);
+        assert(stats[Operation::set_difference].calls == 1);
+        assert(stats[Operation::set_intersection].calls == 0);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 17                                      *
+     * rank, select, and count_in_range                   *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 17: rank, select, and count_in_range\n";
+
+    {
+        std::vector<int> A1{-5, 1, 3, 5, 8, 13, 21};
+        Set S1{A1};
+        Set S2{};
+
+        // Test against a search in the sorted vector
+        for (int val = -7; val <= 23; ++val) {
+            [[maybe_unused]] const auto expected = std::ranges::lower_bound(A1, val) - A1.begin();
+            assert(S1.rank(val) == static_cast<std::size_t>(expected));
+            assert(std::ranges::distance(S1.begin(), S1.lower_bound(val)) == expected);
+
+            for (int hi = val - 1; hi <= 23; ++hi) {
+                [[maybe_unused]] const auto in_range = std::ranges::count_if(A1, [&](int x) { return val <= x && x <= hi; });
+                assert(S1.count_in_range(val, hi) == static_cast<std::size_t>(in_range));
+            }
+        }
+
+        for (std::size_t k = 0; k < A1.size(); ++k) {
+            assert(*S1.select(k) == A1[k]);
+        }
+        assert(S1.select(A1.size()) == S1.end());
+
+        assert(S2.rank(4) == 0);
+        assert(S2.select(0) == S2.end());
+        assert(S2.count_in_range(0, 10) == 0);
+
+        assert(Set::get_count_nodes() == 11);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 18                                      *
+     * contains_batch                                     *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 18: contains_batch\n";
+
+    {
+        std::vector<int> A1{1, 3, 5, 8};
+        Set S1{A1};
+
+        // Unsorted probes with repetitions
+        std::vector<int> probes{8, 0, 3, 9, 3, 4, 1, -2};
+        bool found[8]{};
+        S1.contains_batch(probes, found);
+
+        // Test
+        for (std::size_t i = 0; i < probes.size(); ++i) {
+            assert(found[i] == S1.is_member(probes[i]));
+        }
+
+        // Sorted probes
+        std::vector<int> sorted{0, 1, 2, 5, 8, 10};
+        bool found_sorted[6]{};
+        S1.contains_batch(sorted, found_sorted);
+
+        // Test
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            assert(found_sorted[i] == S1.is_member(sorted[i]));
+        }
+
+        Set{}.contains_batch(sorted, found_sorted);
+        assert(std::ranges::none_of(found_sorted, [](bool b) { return b; }));
+
+        // Sizes that differ: only the probes with an entry in out are answered
+        bool short_out[2]{};
+        S1.contains_batch(probes, short_out);
+        assert(short_out[0] && !short_out[1]);
+
+        bool long_out[8]{true, true, true, true, true, true, true, true};
+        S1.contains_batch(std::span{probes}.first(3), long_out);
+        assert(long_out[0] && !long_out[1] && long_out[2]);
+        assert(std::ranges::all_of(std::span{long_out}.subspan(3), [](bool b) { return b; }));
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 19                                      *
+     * Reuse of the memory of deleted nodes               *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 19: reuse of freed nodes\n";
+
+    {
+        std::vector<int> A1{1, 3, 5};
+        Set S1{A1};
+
+        // Fill the cache with the Nodes of a deleted Set
+        {
+            std::vector<int> A2(100);
+            std::iota(A2.begin(), A2.end(), 0);
+            Set S2{A2};
+        }
+
+        // The cached Nodes are reused
+        Set::reset_stats();
+        for (int i = 0; i < 10; ++i) {
+            Set S2{S1 + i - 3};
+            Set S3{};
+            S3 = S2 * 5;
+        }
+
+        // Test
+        assert(Set::get_stats().allocations > 0);
+        if constexpr (Set::recycles_nodes) {
+            assert(Set::get_stats().heap_allocations == 0);
+        } else {
+            assert(Set::get_stats().heap_allocations == Set::get_stats().allocations);
+        }
+        assert(Set::get_count_nodes() == 5);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 20                                      *
+     * QueryEngine                                        *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 20: boolean queries\n";
+
+    {
+        QueryEngine engine;
+        engine.add("a", Set{std::vector<int>{1, 2, 3, 4, 5, 6}});
+        engine.add("b", Set{std::vector<int>{2, 4, 6, 8}});
+        engine.add("c", Set{std::vector<int>{4, 5, 6, 7}});
+        engine.add("d", Set{6});
+
+        // Test
+        assert((*engine.evaluate("a AND b") == Set{std::vector<int>{2, 4, 6}}));
+        assert(engine.last_stats().cardinality == 3);
+        assert(engine.last_stats().estimated_cardinality == 4);
+
+        assert((*engine.evaluate("b AND NOT c") == Set{std::vector<int>{2, 8}}));
+        assert((*engine.evaluate("(a OR b) AND NOT (c OR d)") == Set{std::vector<int>{1, 2, 3, 8}}));
+        assert(*engine.evaluate("a AND NOT NOT b") == *engine.evaluate("b AND a"));
+        assert(*engine.evaluate("a AND a") == *engine.find("a"));
+        assert(engine.evaluate("d AND NOT a AND b")->is_empty());
+
+        // a OR b is evaluated once
+        assert((*engine.evaluate("((a OR b) AND c) OR ((b OR a) AND NOT d AND c)") == Set{std::vector<int>{4, 5, 6}}));
+        assert(engine.last_stats().reused_subexpressions == 1);
+
+        // Invalid queries
+        for ([[maybe_unused]] const char* query : {"", "a AND", "a AND x", "NOT a", "a OR NOT b", "NOT a AND NOT b", "(a", "a b", "a & b"}) {
+            assert(!engine.evaluate(query));
+            assert(!engine.last_error().empty());
+        }
+
+        // Nesting is bounded, so deep queries are rejected instead of overflowing the stack
+        [[maybe_unused]] const auto nested = [](std::size_t depth, const std::string& open) {
+            std::string query;
+            for (std::size_t i = 0; i < depth; ++i) {
+                query += open;
+            }
+            query += "a";
+            return query + std::string(open == "(" ? depth : 0, ')');
+        };
+        assert(engine.evaluate(nested(256, "(")));
+        assert(!engine.evaluate(nested(257, "(")) && !engine.last_error().empty());
+        assert(!engine.evaluate(nested(100000, "(")));
+        assert(!engine.evaluate("b AND " + nested(100000, "NOT ")));
+
+        assert(engine.evaluate("a"));
+        assert(engine.last_error().empty());
+
+        assert(Set::get_count_nodes() == 23);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 21                                      *
+     * Estimates from cardinality sketches                *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 21: estimates from sketches\n";
+
+    {
+        // Small Sets: the estimates are exact
+        std::vector<int> A1{1, 2, 3};
+        std::vector<int> A2{2, 3, 4, 5};
+        Set S1{A1};
+        Set S2{A2};
+
+        // Test
+        assert(S1.estimate_union_size(S2) == 5);
+        assert(S1.estimate_intersection_size(S2) == 2);
+        assert(S1.estimate_jaccard(S2) == 0.4);
+        assert(Set{}.estimate_jaccard(Set{}) == 1.0);
+
+        // The sketches follow the mutating operators
+        S1 += S2;
+        assert(S1.estimate_union_size(Set{}) == 5);
+        S1 -= Set{3};
+        S1.erase(5);
+        assert(S1.estimate_intersection_size(S2) == 2);
+        S1 *= Set{1};
+        assert(S1.estimate_union_size(S2) == 5);
+
+        // Large Sets: |S3+S4| = 15000, |S3*S4| = 5000
+        std::vector<int> A3(10000);
+        std::iota(A3.begin(), A3.end(), 0);
+        std::vector<int> A4(10000);
+        std::iota(A4.begin(), A4.end(), 5000);
+        Set S3{A3};
+        Set S4{A4};
+
+        [[maybe_unused]] const auto u = S3.estimate_union_size(S4);
+        [[maybe_unused]] const auto i = S3.estimate_intersection_size(S4);
+        assert(u >= 10000 && u <= 20000);
+        assert(i <= 10000);
+        assert(std::abs(S3.estimate_jaccard(S4) - 1.0 / 3.0) < 0.2);
+
+        // After removals the sketch is rebuilt, and matches the sketch of a copy
+        S3 -= S4;
+        S4.erase(7000);
+        assert(S3.estimate_union_size(S4) == Set{S3}.estimate_union_size(Set{S4}));
+        assert(S3.estimate_jaccard(S4) == 0.0);
+
+        // The sketch is allocated on first use, and a copy takes over the sketch of the original
+        static_assert(sizeof(Set) <= 2 * sizeof(void*) + sizeof(Set::size_type) + 2 * sizeof(void*));
+        assert((S3.sketch() != nullptr) == set_sketch::enabled);
+        assert(Set{S3}.estimate_jaccard(S4) == 0.0);
+
+        assert(Set::get_count_nodes() == 1 + 4 + 5000 + 9999 + 4 * 2);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 22                                      *
+     * Set operations on sorted files                     *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 22: Set operations on files\n";
+
+    {
+        // A random suffix keeps runs of the test at the same time from sharing files
+        const auto dir = std::filesystem::temp_directory_path();
+        const std::string tag{"lab2_" + std::to_string(std::random_device{}()) + "_"};
+        const std::string f1{(dir / (tag + "s1.bin")).string()};
+        const std::string f2{(dir / (tag + "s2.bin")).string()};
+        const std::string f3{(dir / (tag + "s3.bin")).string()};
+        const std::string out{(dir / (tag + "out.bin")).string()};
+        const std::size_t buffer_size = 4;  // small buffers, so that the merges cross many buffers
+
+        std::vector<int> A1, A2;
+        for (int i = 0; i < 100; ++i) {
+            A1.push_back(3 * i);
+            A2.push_back(2 * i + 50);
+        }
+        std::vector<int> A3{0, 6, 60, 61, 120, 250, 500};
+        Set S1{A1};
+        Set S2{A2};
+        Set S3{A3};
+
+        assert(external_set::write_file(S1, f1));
+        assert(external_set::write_file(S2, f2));
+        assert(external_set::write_file(S3, f3));
+        assert((*external_set::read_file(f1, buffer_size) == S1));
+
+        // Test
+        const std::string files[] = {f1, f2, f3};
+
+        auto n = external_set::union_files(files, out, buffer_size);
+        assert(n && *n == (S1 + S2 + S3).cardinality());
+        assert((*external_set::read_file(out) == S1 + S2 + S3));
+
+        n = external_set::intersection_files(files, out, buffer_size);
+        assert((n && *n == 2));
+        assert((*external_set::read_file(out) == S1 * S2 * S3));
+
+        n = external_set::difference_files(f1, std::span{files}.subspan(1), out, buffer_size);
+        assert((*external_set::read_file(out) == S1 - S2 - S3));
+
+        n = external_set::difference_files(f1, std::span{files}.first(1), out, buffer_size);
+        assert((n && *n == 0));
+
+        // Repeated values are written once
+        {
+            const int values[] = {1, 1, 2, 5, 5, 5, 8};
+            std::ofstream os{f3, std::ios::binary};
+            os.write(reinterpret_cast<const char*>(values), sizeof(values));
+        }
+        assert((*external_set::read_file(f3, buffer_size) == Set{std::vector<int>{1, 2, 5, 8}}));
+
+        // Files that are not sorted, or end in the middle of a value, are rejected
+        {
+            const int values[] = {1, 4, 3};
+            std::ofstream os{f3, std::ios::binary};
+            os.write(reinterpret_cast<const char*>(values), sizeof(values));
+        }
+        assert(!external_set::read_file(f3, buffer_size));
+
+        // A failed operation leaves no output behind
+        std::filesystem::remove(out);
+        assert(!external_set::union_files(files, out, buffer_size));
+        assert(!std::filesystem::exists(out) && !std::filesystem::exists(out + ".partial"));
+
+        // Also when the merge ends before the values that are not sorted
+        {
+            const int values[] = {0, 1000, 3};
+            std::ofstream os{f3, std::ios::binary};
+            os.write(reinterpret_cast<const char*>(values), sizeof(values));
+        }
+        assert(!external_set::intersection_files(files, out, buffer_size));
+        assert(!external_set::difference_files(f2, std::span{files}.subspan(2), out, buffer_size));
+        {
+            std::ofstream os{f3, std::ios::binary};
+            os.write("abcde", 5);
+        }
+        assert(!external_set::read_file(f3, buffer_size));
+        assert(!external_set::intersection_files(std::span{files}.subspan(1), out, buffer_size));
+        assert(!external_set::read_file((dir / (tag + "missing.bin")).string()));
+
+        for (const auto& f : {f1, f2, f3, out}) {
+            std::filesystem::remove(f);
+        }
+
+        assert(Set::get_count_nodes() == 100 + 100 + 7 + 3 * 2);
+    }
+
+    assert(Set::get_count_nodes() == 0);
+
+    /*****************************************************
+     * TEST PHASE 23                                      *
+     * is_member with the membership prefilter            *
+     ******************************************************/
+    std::cout << "\nTEST PHASE 23: membership prefilter\n";
+
+    {
+        // The filter never rejects an added value, and rejects most others
+        set_prefilter::Filter filter{1000};
+        for (int i = 0; i < 1000; ++i) {
+            assert(filter.add(set_prefilter::hash(2 * i)));
+        }
+        int false_positives = 0;
+        for (int i = 0; i < 1000; ++i) {
+            assert(filter.may_contain(set_prefilter::hash(2 * i)));
+            false_positives += filter.may_contain(set_prefilter::hash(2 * i + 1));
+        }
+        assert(false_positives < 1000 * 3 * set_prefilter::fp_rate + 5);
+
+        // is_member stays exact while the Set changes
+        std::vector<int> A1(500);
+        std::ranges::generate(A1, [i = 0]() mutable { return 2 * i++; });
+        Set S1{A1};
+
+        const auto check = [&S1] {
+            for (int i = -1; i <= 1001; ++i) {
+                assert(S1.is_member(i) == std::ranges::binary_search(S1, i));
+            }
+        };
+
+        check();
+        S1.insert(7);
+        check();
+        S1.erase(10);
+        check();
+        S1 += Set{std::vector<int>{1, 3, 5}};
+        S1 -= Set{std::vector<int>{0, 2, 4}};
+        check();
+
+        // Removals keep the filter, until a quarter of its values are gone
+        for (int i = 100; i < 200; i += 2) {
+            S1.erase(i);
+            assert(!S1.is_member(i) && S1.is_member(i + 200));
+        }
+        check();
+
+        Set S2{S1};  // copies the filter
+        S1 *= Set{std::vector<int>{1, 7, 8}};
+        assert(S1.is_member(7) && !S1.is_member(6) && !S1.is_member(3));
+        assert(S2.is_member(3) && !S2.is_member(4));
+
+        assert(Set::get_count_nodes() == 3 + 2 + static_cast<int>(S2.cardinality()) + 2);
+    }
+
     assert(Set::get_count_nodes() == 0);
     std::cout << "Success!!\n";
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+
+/** Slot for data derived from the values of a Set, such as a filter, built on first use
+ *
+ * The data is built by const member functions of Set, so several threads may build it at the same time:
+ * the first one installs its copy, and the others delete theirs and use the installed one
+ * Member functions that modify the Set are never concurrent with other calls on it,
+ * so they update or drop the data directly
+ *
+ * NoSlot has the same interface and never holds data, for features that are compiled out
+ */
+template <typename T>
+class LazySlot {
+public:
+    LazySlot() = default;
+
+    ~LazySlot() {
+        delete ptr.load(std::memory_order_relaxed);
+    }
+
+    LazySlot(const LazySlot&) = delete;
+    LazySlot& operator=(const LazySlot&) = delete;
+
+    /*
+     * Return the data, or nullptr if it is not built
+     */
+    T* get() {
+        return ptr.load(std::memory_order_relaxed);
+    }
+
+    const T* get() const {
+        return ptr.load(std::memory_order_acquire);
+    }
+
+    /*
+     * Return the data, building it with build() if it is not built yet
+     */
+    template <typename Build>
+    const T* get_or_build(Build build) const {
+        if (const T* p = ptr.load(std::memory_order_acquire)) {
+            return p;
+        }
+
+        T* fresh = new T(build());
+        T* installed = nullptr;
+        if (ptr.compare_exchange_strong(installed, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return fresh;
+        }
+        delete fresh;
+        return installed;
+    }
+
+    /*
+     * Replace the data by p, which may be nullptr
+     */
+    void set(T* p) {
+        delete ptr.exchange(p, std::memory_order_relaxed);
+    }
+
+    /*
+     * Drop the data, it is built again on next use
+     */
+    void reset() {
+        if (get() != nullptr) {
+            set(nullptr);
+        }
+    }
+
+    void swap(LazySlot& other) {
+        T* p = ptr.load(std::memory_order_relaxed);
+        ptr.store(other.ptr.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        other.ptr.store(p, std::memory_order_relaxed);
+    }
+
+private:
+    mutable std::atomic<T*> ptr{nullptr};
+};
+
+template <typename T>
+class NoSlot {
+public:
+    T* get() {
+        return nullptr;
+    }
+
+    const T* get() const {
+        return nullptr;
+    }
+
+    template <typename Build>
+    const T* get_or_build(Build) const {
+        return nullptr;
+    }
+
+    void set(T* p) {
+        delete p;
+    }
+
+    void reset() {
+    }
+
+    void swap(NoSlot&) {
+    }
+};
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <new>
+
+#include "instrumentation.h"
 
 /** Class Set::Node
  *
- * This class represents an internal node of a doubly linked list storing an int
+ * This class represents an internal node of a doubly linked list storing a Set value
  * All members of class Set::Node are public
  * but only class Set can access them, since Node is declared in the private part of class Set
  *
@@ -13,23 +17,32 @@ class Set::Node {
 public:
     /*
      * Constructor
-     * \param nodeVal int to be stored in the Node
+     * \param nodeVal value to be stored in the Node
      * \param nextPtr a pointer to the next Node in the list
      * \param prevPtr a pointer to the previous Node in the list
      */
-    explicit Node(int nodeVal = 0, Node* nextPtr = nullptr, Node* prevPtr = nullptr)
+    explicit Node(value_type nodeVal = value_type{}, Node* nextPtr = nullptr, Node* prevPtr = nullptr)
         : value{nodeVal}, next{nextPtr}, prev{prevPtr} {
-        ++count_nodes;
+        set_instrumentation::node_created();
     }
 
     /*
      * Destructor
      */
     ~Node() {
-        --count_nodes;
-        assert(count_nodes >= 0);  // number of existing nodes can never be negative
+        set_instrumentation::node_destroyed();
+        assert(set_instrumentation::live_nodes() >= 0);  // number of existing nodes can never be negative
     }
 
+    /*
+     * Allocation and deallocation of Nodes, recorded by the instrumentation
+     * If Set::recycles_nodes is true, memory of deleted Nodes is kept in a small per-thread cache and reused by new Nodes,
+     * so short-lived Sets (e.g. the dummy nodes of temporaries) seldom reach the heap
+     * Defined in set.cpp
+     */
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
     /*
      * Copy constructor -- disallowed to avoid shallow copying
      */
@@ -41,9 +54,7 @@ public:
     Node& operator=(const Node& rhs) = delete;
 
     // Data members
-    int value;   // int stored in the Node
+    value_type value;  // value stored in the Node
     Node* next;  // Pointer to the next Node
     Node* prev;  // Pointer to the previous Node
-
-    static int count_nodes;  // total number of existing nodes -- to help to detect bugs in the code
 };
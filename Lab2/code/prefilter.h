@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+
+/** Membership prefilter of class Set
+ *
+ * Built with SET_PREFILTER defined (CMake option SET_PREFILTER, ON by default),
+ * Set::is_member first asks a blocked Bloom filter of the values of the Set
+ * A value is mapped to one block of 512 bits, a single cache line, and to k bits in that block
+ * If one of the bits is not set, the value does not belong to the Set and the list is not searched
+ *
+ * The filter is built on the first is_member call, in O(n)
+ * Inserted values are added to it while it has room
+ * Removed values keep their bits, which only adds false positives, so the filter is kept
+ * until more than a quarter of the values added to it were removed, then dropped until the next is_member call
+ *
+ * SET_PREFILTER_FP_RATE (CMake cache variable, 0.01 by default) is the target rate of false positives,
+ * it sets the number of bits per value and k
+ */
+namespace set_prefilter {
+
+#ifdef SET_PREFILTER
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+#ifndef SET_PREFILTER_FP_RATE
+#define SET_PREFILTER_FP_RATE 0.01
+#endif
+
+inline constexpr double fp_rate = SET_PREFILTER_FP_RATE;
+static_assert(fp_rate > 0.0 && fp_rate < 1.0, "SET_PREFILTER_FP_RATE must be in (0, 1)");
+
+/*
+ * Hash of val, mixed with the finalizer of MurmurHash3
+ */
+template <typename T>
+std::uint64_t hash(const T& val) {
+    std::uint64_t h = std::hash<T>{}(val);
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+    h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+class Filter {
+public:
+    /*
+     * Empty filter with room for n values
+     */
+    explicit Filter(std::size_t n) {
+        const double ln2 = std::log(2.0);
+        const double bits_per_value = -std::log(fp_rate) / (ln2 * ln2);
+
+        // k bit positions of 9 bits each are taken from one 64-bit number
+        k = std::clamp(static_cast<unsigned>(std::lround(-std::log2(fp_rate))), 1u, 7u);
+
+        const auto bits = static_cast<std::size_t>(std::ceil(bits_per_value * static_cast<double>(std::max<std::size_t>(n, 1))));
+        blocks.resize((bits + block_bits - 1) / block_bits);
+        capacity = static_cast<std::size_t>(static_cast<double>(blocks.size() * block_bits) / bits_per_value);
+    }
+
+    /*
+     * Add the value with hash h, O(1)
+     * Return false, and leave the filter unchanged, if the filter is full
+     */
+    bool add(std::uint64_t h) {
+        if (count == capacity) {
+            return false;
+        }
+        ++count;
+
+        Block& b = blocks[block_index(h)];
+        const std::uint64_t g = positions(h);
+        for (unsigned j = 0; j < k; ++j) {
+            const auto bit = (g >> (9 * j)) & 511;
+            b.words[bit / 64] |= std::uint64_t{1} << (bit % 64);
+        }
+        return true;
+    }
+
+    /*
+     * Record that m added values were removed from the Set, O(1)
+     * Their bits stay set, so the filter still never rejects a value of the Set
+     * Return false once more than a quarter of the added values were removed, the filter should then be rebuilt
+     */
+    bool remove(std::size_t m = 1) {
+        removed += m;
+        return 4 * removed <= count;
+    }
+
+    /*
+     * Test whether the value with hash h may have been added, O(1)
+     * Return false only if it was not added
+     */
+    bool may_contain(std::uint64_t h) const {
+        const Block& b = blocks[block_index(h)];
+        const std::uint64_t g = positions(h);
+        for (unsigned j = 0; j < k; ++j) {
+            const auto bit = (g >> (9 * j)) & 511;
+            if ((b.words[bit / 64] & (std::uint64_t{1} << (bit % 64))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr std::size_t block_bits = 512;
+
+    struct alignas(64) Block {
+        std::uint64_t words[block_bits / 64]{};
+    };
+
+    /*
+     * Index of the block of the value with hash h, chosen by the high 32 bits of h
+     */
+    std::size_t block_index(std::uint64_t h) const {
+        return static_cast<std::size_t>(((h >> 32) * blocks.size()) >> 32);
+    }
+
+    /*
+     * Bit positions in the block, 9 bits each, from h mixed again
+     */
+    static std::uint64_t positions(std::uint64_t h) {
+        return h * 0x9e3779b97f4a7c15ULL;
+    }
+
+    std::vector<Block> blocks;
+    std::size_t count = 0;     // number of added values
+    std::size_t removed = 0;   // number of added values removed from the Set
+    std::size_t capacity = 0;  // number of values the filter holds at fp_rate
+    unsigned k = 1;            // bits per value
+};
+
+}  // namespace set_prefilter
@@ -0,0 +1,348 @@
+#include "query.h"
+
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <chrono>
+#include <cctype>
+#include <cstddef>
+#include <utility>
+
+/*****************************************************
+ * Parsing and planning of queries                    *
+ ******************************************************/
+
+/*
+ * Node of a parsed query
+ * Nested ANDs and ORs are flattened, so an AND never has an AND operand, and an OR never has an OR operand
+ */
+struct QueryEngine::Expr {
+    enum class Kind { name, op_and, op_or, op_not };
+
+    Kind kind = Kind::name;
+    std::string name;                             // for Kind::name, the name of a Set in QueryEngine::sets
+    std::vector<std::unique_ptr<Expr>> operands;  // operands of AND, OR, and NOT, in evaluation order
+    std::string key;                              // canonical form of the expression: equal keys, equal results
+    Set::size_type estimate = 0;                  // upper bound on the cardinality of the result
+};
+
+/*
+ * Recursive descent parser, see the grammar in query.h
+ * Each node is planned as soon as it is parsed, see plan()
+ * On an error, parse() returns nullptr and error() describes the problem
+ */
+class QueryEngine::Parser {
+public:
+    // Every NOT and '(' is one more level of recursion, so their nesting is bounded to protect the stack
+    static constexpr std::size_t max_depth = 256;
+
+    Parser(const std::string& query, const std::map<std::string, Set>& named_sets)
+        : text{query}, sets{named_sets} {
+    }
+
+    std::unique_ptr<Expr> parse() {
+        next();
+        auto e = or_expr();
+        if (!e) {
+            return nullptr;
+        }
+        if (!token.empty()) {
+            return fail("unexpected '" + token + "'");
+        }
+        if (e->kind == Kind::op_not) {
+            return fail("NOT must be an operand of an AND");
+        }
+        return e;
+    }
+
+    const std::string& error() const {
+        return message;
+    }
+
+private:
+    using Kind = Expr::Kind;
+
+    /*
+     * Read the next token, token is empty at the end of the query
+     */
+    void next() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            ++pos;
+        }
+
+        const std::size_t start = pos;
+        if (pos < text.size() && (text[pos] == '(' || text[pos] == ')')) {
+            ++pos;
+        } else {
+            while (pos < text.size() && is_name_char(text[pos])) {
+                ++pos;
+            }
+            if (pos == start && pos < text.size()) {
+                ++pos;  // a character that cannot start a token, reported by factor()
+            }
+        }
+        token = text.substr(start, pos - start);
+    }
+
+    static bool is_name_char(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' || c == '.';
+    }
+
+    std::unique_ptr<Expr> or_expr() {
+        return chain(Kind::op_or, "OR", &Parser::and_expr);
+    }
+
+    std::unique_ptr<Expr> and_expr() {
+        return chain(Kind::op_and, "AND", &Parser::factor);
+    }
+
+    /*
+     * Parse operand { keyword operand } into one node of the given kind
+     * Operands of the same kind are flattened into the node
+     */
+    std::unique_ptr<Expr> chain(Kind kind, const char* keyword, std::unique_ptr<Expr> (Parser::*operand)()) {
+        auto first = (this->*operand)();
+        if (!first || token != keyword) {
+            return first;
+        }
+
+        auto e = std::make_unique<Expr>();
+        e->kind = kind;
+        append(*e, std::move(first));
+
+        while (token == keyword) {
+            next();
+            auto rhs = (this->*operand)();
+            if (!rhs) {
+                return nullptr;
+            }
+            append(*e, std::move(rhs));
+        }
+        return plan(std::move(e));
+    }
+
+    static void append(Expr& parent, std::unique_ptr<Expr> child) {
+        if (child->kind == parent.kind) {
+            std::ranges::move(child->operands, std::back_inserter(parent.operands));
+        } else {
+            parent.operands.push_back(std::move(child));
+        }
+    }
+
+    std::unique_ptr<Expr> factor() {
+        if ((token == "NOT" || token == "(") && depth == max_depth) {
+            return fail("query nested more than " + std::to_string(max_depth) + " levels deep");
+        }
+
+        if (token == "NOT") {
+            next();
+            ++depth;
+            auto operand = factor();
+            --depth;
+            if (!operand) {
+                return nullptr;
+            }
+            if (operand->kind == Kind::op_not) {
+                return std::move(operand->operands.front());  // NOT NOT A is A
+            }
+            auto e = std::make_unique<Expr>();
+            e->kind = Kind::op_not;
+            e->operands.push_back(std::move(operand));
+            return plan(std::move(e));
+        }
+        if (token == "(") {
+            next();
+            ++depth;
+            auto e = or_expr();
+            --depth;
+            if (!e) {
+                return nullptr;
+            }
+            if (token != ")") {
+                return fail(token.empty() ? "expected ')'" : "expected ')' instead of '" + token + "'");
+            }
+            next();
+            return e;
+        }
+        if (token.empty()) {
+            return fail("unexpected end of query");
+        }
+        if (token == "AND" || token == "OR" || !is_name_char(token[0])) {
+            return fail("unexpected '" + token + "'");
+        }
+
+        auto e = std::make_unique<Expr>();
+        e->name = token;
+        next();
+        return plan(std::move(e));
+    }
+
+    /*
+     * Compute the key and the estimate of e, and order the operands of an AND for evaluation
+     * - the key of an AND or an OR lists the keys of its operands in sorted order,
+     *   so that A AND B and B AND A are recognized as the same sub-expression
+     * - repeated operands of an AND or an OR are dropped
+     * - an AND is evaluated from its smallest to its largest operand, and its NOT operands last
+     */
+    std::unique_ptr<Expr> plan(std::unique_ptr<Expr> e) {
+        switch (e->kind) {
+            case Kind::name: {
+                auto it = sets.find(e->name);
+                if (it == sets.end()) {
+                    return fail("unknown name '" + e->name + "'");
+                }
+                e->key = e->name;
+                e->estimate = it->second.cardinality();
+                return e;
+            }
+            case Kind::op_not:
+                e->key = "NOT(" + e->operands.front()->key + ")";
+                e->estimate = e->operands.front()->estimate;
+                return e;
+            default:
+                break;
+        }
+
+        auto& operands = e->operands;
+        const bool is_and = (e->kind == Kind::op_and);
+
+        std::ranges::sort(operands, {}, &Expr::key);
+        const auto [first, last] = std::ranges::unique(operands, {}, &Expr::key);
+        operands.erase(first, last);
+
+        e->key = is_and ? "AND(" : "OR(";
+        for (const auto& x : operands) {
+            if (!is_and && x->kind == Kind::op_not) {
+                return fail("NOT must be an operand of an AND");
+            }
+            e->key += x->key;
+            e->key += (&x == &operands.back()) ? ")" : " ";
+        }
+
+        if (is_and) {
+            std::ranges::stable_sort(operands, [](const auto& x, const auto& y) {
+                const bool x_not = (x->kind == Kind::op_not);
+                const bool y_not = (y->kind == Kind::op_not);
+                return (x_not != y_not) ? y_not : (!x_not && x->estimate < y->estimate);
+            });
+            if (operands.front()->kind == Kind::op_not) {
+                return fail("an AND needs an operand that is not a NOT");
+            }
+            e->estimate = operands.front()->estimate;
+        } else {
+            for (const auto& x : operands) {
+                e->estimate += x->estimate;
+            }
+        }
+        return e;
+    }
+
+    std::unique_ptr<Expr> fail(std::string what) {
+        if (message.empty()) {
+            message = std::move(what);
+        }
+        return nullptr;
+    }
+
+    const std::string& text;
+    const std::map<std::string, Set>& sets;
+    std::size_t pos = 0;
+    std::size_t depth = 0;  // number of NOTs and '(' around the current factor
+    std::string token;
+    std::string message;
+};
+
+/*****************************************************
+ * QueryEngine                                        *
+ ******************************************************/
+
+/*
+ * Add a Set with the given name, replacing any Set with the same name
+ */
+void QueryEngine::add(const std::string& name, Set S) {
+    sets.insert_or_assign(name, std::move(S));
+}
+
+/*
+ * Return the Set with the given name, or nullptr if there is none
+ */
+const Set* QueryEngine::find(const std::string& name) const {
+    auto it = sets.find(name);
+    return (it == sets.end()) ? nullptr : &it->second;
+}
+
+/*
+ * Evaluate query
+ * Return std::nullopt if the query is not valid, last_error() then describes the problem
+ */
+std::optional<Set> QueryEngine::evaluate(const std::string& query) {
+    using clock = std::chrono::steady_clock;
+    const auto elapsed_ns = [](clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+    };
+
+    stats = Stats{};
+    error.clear();
+
+    const auto parse_start = clock::now();
+    Parser parser{query, sets};
+    const auto e = parser.parse();
+    stats.parse_ns = elapsed_ns(parse_start);
+
+    if (!e) {
+        error = parser.error();
+        return std::nullopt;
+    }
+    stats.estimated_cardinality = e->estimate;
+
+    const auto evaluation_start = clock::now();
+    std::map<std::string, Set> memo;
+    const Set* R = evaluate(*e, memo);
+
+    // A named Set is copied, a computed result is moved out of memo
+    std::optional<Set> result{(e->kind == Expr::Kind::name) ? Set{*R} : std::move(memo.find(e->key)->second)};
+    stats.evaluation_ns = elapsed_ns(evaluation_start);
+    stats.cardinality = result->cardinality();
+
+    return result;
+}
+
+/*
+ * Evaluate e, reusing results of sub-expressions stored in memo
+ * Return a pointer to a named Set or to a result in memo
+ */
+const Set* QueryEngine::evaluate(const Expr& e, std::map<std::string, Set>& memo) {
+    if (e.kind == Expr::Kind::name) {
+        return &sets.find(e.name)->second;
+    }
+    if (auto it = memo.find(e.key); it != memo.end()) {
+        ++stats.reused_subexpressions;
+        return &it->second;
+    }
+
+    Set result{};
+    if (e.kind == Expr::Kind::op_or) {
+        std::vector<const Set*> operands;
+        operands.reserve(e.operands.size());
+
+        for (const auto& x : e.operands) {
+            operands.push_back(evaluate(*x, memo));
+        }
+        result = Set::union_all(operands);
+    } else {
+        // AND, operands ordered by Parser::plan: smallest first, NOTs last
+        result = *evaluate(*e.operands.front(), memo);
+
+        for (auto it = std::next(e.operands.begin()); it != e.operands.end() && !result.is_empty(); ++it) {
+            const Expr& x = **it;
+
+            if (x.kind == Expr::Kind::op_not) {
+                result -= *evaluate(*x.operands.front(), memo);
+            } else {
+                result *= *evaluate(x, memo);
+            }
+        }
+    }
+    return &memo.emplace(e.key, std::move(result)).first->second;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <optional>
+
+#include "set.h"
+
+/** Class QueryEngine
+ *
+ * Evaluates boolean queries over named Sets, such as posting lists of document ids per term
+ *
+ * Grammar of a query, where a name is a sequence of letters, digits, '_', '-' and '.'
+ *   query    := or_expr
+ *   or_expr  := and_expr { OR and_expr }
+ *   and_expr := factor { AND factor }
+ *   factor   := NOT factor | ( or_expr ) | name
+ *
+ * Queries are planned before they are evaluated:
+ * - the operands of an AND are intersected from the smallest to the largest estimated cardinality,
+ *   and the intersection stops as soon as it is empty
+ * - NOT operands of an AND become Set differences, A AND NOT B is evaluated as A - B
+ * - the operands of an OR are merged in one pass with Set::union_all
+ * - sub-expressions that occur more than once in a query are evaluated once
+ * Named Sets are used in place and only the results of AND and OR are built
+ *
+ * There is no universe to complement against, so NOT is only allowed inside an AND
+ * with at least one operand that is not a NOT
+ *
+ * Parentheses and NOTs nest at most 256 levels deep, deeper queries are not valid
+ */
+class QueryEngine {
+public:
+    /*
+     * Information about the last evaluated query
+     */
+    struct Stats {
+        Set::size_type estimated_cardinality = 0;  // upper bound on the size of the result, from the plan
+        Set::size_type cardinality = 0;            // size of the result
+        std::size_t reused_subexpressions = 0;     // sub-expressions whose result was reused
+        long long parse_ns = 0;                    // time to parse and plan the query, in nanoseconds
+        long long evaluation_ns = 0;               // time to evaluate the query, in nanoseconds
+    };
+
+    /*
+     * Add a Set with the given name, replacing any Set with the same name
+     */
+    void add(const std::string& name, Set S);
+
+    /*
+     * Return the Set with the given name, or nullptr if there is none
+     */
+    const Set* find(const std::string& name) const;
+
+    /*
+     * Evaluate query
+     * Return std::nullopt if the query is not valid, last_error() then describes the problem
+     */
+    std::optional<Set> evaluate(const std::string& query);
+
+    /*
+     * Return information about the last evaluated query
+     */
+    const Stats& last_stats() const {
+        return stats;
+    }
+
+    /*
+     * Return the reason why the last query was not valid, or an empty string
+     */
+    const std::string& last_error() const {
+        return error;
+    }
+
+private:
+    struct Expr;    // node of a parsed query, defined in query.cpp
+    class Parser;   // recursive descent parser, defined in query.cpp
+
+    /*
+     * Evaluate e, reusing results of sub-expressions stored in memo
+     * Return a pointer to a named Set or to a result in memo
+     */
+    const Set* evaluate(const Expr& e, std::map<std::string, Set>& memo);
+
+    std::map<std::string, Set> sets;  // named Sets
+    Stats stats;
+    std::string error;
+};
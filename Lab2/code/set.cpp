@@ -1,17 +1,357 @@
 #include "set.h"
 #include "node.h"
 
-int Set::Node::count_nodes = 0;
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <numeric>
+#include <utility>
+#include <string>
+#include <limits>
+#include <cstdint>
+#include <type_traits>
+#include <cmath>
+
+/*****************************************************
+ * Helpers for the binary format of a Set             *
+ ******************************************************/
+
+namespace {
+
+constexpr char binary_magic[4] = {'T', 'S', 'E', 'T'};
+constexpr std::size_t binary_block_size = 128;  // number of values per block
+
+/*
+ * Append x to buffer as a varint: 7 bits per byte, the high bit tells whether more bytes follow
+ */
+void append_varint(std::string& buffer, std::uint64_t x) {
+    while (x >= 0x80) {
+        buffer.push_back(static_cast<char>((x & 0x7F) | 0x80));
+        x >>= 7;
+    }
+    buffer.push_back(static_cast<char>(x));
+}
+
+/*
+ * Read a varint from stream is into x, and add the number of bytes read to consumed
+ * Return false and set the failbit of is, if is does not hold a valid varint
+ */
+bool read_varint(std::istream& is, std::uint64_t& x, std::uint64_t& consumed) {
+    x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const auto c = is.get();
+        if (c == std::istream::traits_type::eof()) {
+            is.setstate(std::ios::failbit);
+            return false;
+        }
+        ++consumed;
+        x |= static_cast<std::uint64_t>(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    is.setstate(std::ios::failbit);
+    return false;
+}
+
+/*
+ * Zigzag encoding maps small negative and positive values to small unsigned values
+ */
+std::uint64_t zigzag_encode(std::int64_t v) {
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+std::int64_t zigzag_decode(std::uint64_t u) {
+    return static_cast<std::int64_t>(u >> 1) ^ -static_cast<std::int64_t>(u & 1);
+}
+
+bool read_varint(std::istream& is, std::uint64_t& x) {
+    std::uint64_t consumed = 0;
+    return read_varint(is, x, consumed);
+}
+
+constexpr auto max_offset = static_cast<std::uint64_t>(std::numeric_limits<std::streamoff>::max());
+
+/*
+ * Move stream is forward by bytes, without reading them
+ * Return false and set the failbit of is, if the seek fails or is ends before the target position
+ */
+bool skip_bytes(std::istream& is, std::uint64_t bytes) {
+    if (bytes == 0) {
+        return static_cast<bool>(is);
+    }
+    
+    const std::istream::pos_type here = is.tellg();
+    if (!is || bytes > max_offset) {
+        is.setstate(std::ios::failbit);
+        return false;
+    }
+    
+    // Seeking past the end succeeds on some streams, so the size of the rest of the stream is checked first
+    if (!is.seekg(0, std::ios::end) || static_cast<std::uint64_t>(is.tellg() - here) < bytes) {
+        is.setstate(std::ios::failbit);
+        return false;
+    }
+    return static_cast<bool>(is.seekg(here + static_cast<std::streamoff>(bytes)));
+}
+
+/*
+ * The binary format stores integers of at most 64 bits
+ * The functions below are templates, so that they are only compiled when Set::value_type is such an integer
+ */
+template <typename T>
+constexpr bool binary_format_supported = std::is_integral_v<T> && sizeof(T) <= sizeof(std::int64_t);
+
+/*
+ * Write the values of S to stream os, see Set::write_binary, O(n)
+ */
+template <typename T>
+void write_integers(const Set& S, std::ostream& os) {
+    std::string index;
+    std::string blocks;
+    std::uint64_t n_blocks = 0;
+    
+    auto it = S.begin();
+    while (it != S.end()) {
+        const std::size_t block_start = blocks.size();
+        const T first = *it;
+        T prev = first;
+        ++it;
+        
+        for (std::size_t i = 1; i < binary_block_size && it != S.end(); ++i) {
+            // Values are strictly increasing, so the difference is positive and fits in 64 bits
+            const T val = *it;
+            append_varint(blocks, static_cast<std::uint64_t>(val) - static_cast<std::uint64_t>(prev));
+            prev = val;
+            ++it;
+        }
+        
+        append_varint(index, zigzag_encode(static_cast<std::int64_t>(first)));
+        append_varint(index, blocks.size() - block_start);
+        ++n_blocks;
+    }
+    
+    std::string header;
+    append_varint(header, S.cardinality());
+    append_varint(header, n_blocks);
+    
+    os.write(binary_magic, sizeof(binary_magic));
+    os.write(header.data(), header.size());
+    os.write(index.data(), index.size());
+    os.write(blocks.data(), blocks.size());
+}
+
+/*
+ * Read the values in [lo, hi] of a Set written by write_integers from stream is, see Set::read_binary
+ * Blocks before lo are skipped with seekg and reading stops after the last block that can hold hi,
+ * the stream is left positioned after the Set in both cases, O(index + values decoded)
+ */
+template <typename T>
+Set read_integers(std::istream& is, T lo, T hi) {
+    Set result{};
+    
+    char magic[sizeof(binary_magic)]{};
+    std::uint64_t n = 0;
+    std::uint64_t n_blocks = 0;
+    
+    // One block per binary_block_size values, the last block may hold fewer
+    if (!is.read(magic, sizeof(magic)) || !std::ranges::equal(magic, binary_magic) ||
+        !read_varint(is, n) || !read_varint(is, n_blocks) ||
+        n_blocks != n / binary_block_size + (n % binary_block_size != 0)) {
+        is.setstate(std::ios::failbit);
+        return result;
+    }
+    
+    struct Block {
+        T first;
+        std::uint64_t bytes;
+    };
+    std::vector<Block> index;
+    index.reserve(std::min<std::uint64_t>(n_blocks, 4096));
+    
+    std::uint64_t remaining_bytes = 0;  // size of the blocks not read yet
+    for (std::uint64_t i = 0; i < n_blocks; ++i) {
+        std::uint64_t first = 0;
+        std::uint64_t bytes = 0;
+        if (!read_varint(is, first) || !read_varint(is, bytes)) {
+            return result;
+        }
+        
+        // First values must fit in T and increase from block to block,
+        // and the sizes must add up to a valid stream offset
+        const std::int64_t decoded = zigzag_decode(first);
+        if (!std::in_range<T>(decoded) || (!index.empty() && static_cast<T>(decoded) <= index.back().first) ||
+            bytes > max_offset - remaining_bytes) {
+            is.setstate(std::ios::failbit);
+            return result;
+        }
+        index.push_back(Block{static_cast<T>(decoded), bytes});
+        remaining_bytes += bytes;
+    }
+    
+    bool decoded_any = false;
+    T last{};  // last value decoded
+    std::uint64_t skipped = 0;  // bytes of the blocks before lo, passed over in one seek
+    
+    for (std::size_t i = 0; i < index.size() && index[i].first <= hi; ++i) {
+        // All values of block i are smaller than the first value of block i+1
+        if (i + 1 < index.size() && index[i + 1].first <= lo) {
+            skipped += index[i].bytes;
+            remaining_bytes -= index[i].bytes;
+            continue;
+        }
+        if (!skip_bytes(is, skipped)) {
+            return result;
+        }
+        skipped = 0;
+        
+        if (decoded_any && index[i].first <= last) {
+            is.setstate(std::ios::failbit);
+            return result;
+        }
+        
+        const std::uint64_t n_values = std::min<std::uint64_t>(binary_block_size, n - i * binary_block_size);
+        std::uint64_t consumed = 0;  // bytes of the block read so far
+        T val = index[i].first;
+        
+        for (std::uint64_t k = 0; k < n_values; ++k) {
+            if (k > 0) {
+                std::uint64_t delta = 0;
+                if (!read_varint(is, delta, consumed) || delta == 0 ||
+                    delta > static_cast<std::uint64_t>(std::numeric_limits<T>::max()) - static_cast<std::uint64_t>(val)) {
+                    is.setstate(std::ios::failbit);
+                    return result;
+                }
+                val = static_cast<T>(static_cast<std::uint64_t>(val) + delta);
+            }
+            if (lo <= val && val <= hi) {
+                result.insert(val);  // values increase, so each one is appended in O(1)
+            }
+        }
+        
+        // remaining_bytes and the final seekg rely on the sizes in the index
+        if (consumed != index[i].bytes) {
+            is.setstate(std::ios::failbit);
+            return result;
+        }
+        decoded_any = true;
+        last = val;
+        remaining_bytes -= index[i].bytes;
+    }
+    
+    skip_bytes(is, skipped + remaining_bytes);
+    return result;
+}
+
+/*****************************************************
+ * Cache of memory for freed Nodes                    *
+ ******************************************************/
+
+/*
+ * A freed Node's memory holds the link to the next free Node
+ */
+struct FreeSlot {
+    FreeSlot* next;
+};
+
+/*
+ * Per-thread stack of freed Nodes, at most capacity of them
+ * Trivially destructible, so it stays usable while the thread's other objects are destroyed
+ */
+struct NodeCache {
+    static constexpr std::size_t capacity = 256;
+
+    FreeSlot* first = nullptr;
+    std::size_t size = 0;
+    bool closed = false;  // the cache was released, Nodes deleted after that go back to the heap
+};
+
+thread_local NodeCache node_cache;
+
+/*
+ * Give the cached memory back to the heap when the thread ends
+ */
+struct NodeCacheRelease {
+    ~NodeCacheRelease() {
+        while (node_cache.first != nullptr) {
+            FreeSlot* slot = node_cache.first;
+            node_cache.first = slot->next;
+            ::operator delete(slot);
+        }
+        node_cache.size = 0;
+        node_cache.closed = true;
+    }
+};
+
+thread_local NodeCacheRelease node_cache_release;
+
+}  // namespace
+
+using set_instrumentation::Operation;
+using set_instrumentation::ScopedOperation;
 
 /*****************************************************
  * Implementation of the member functions             *
  ******************************************************/
 
 /*
- *  Default constructor :create an empty Set
+ * Allocate memory for a Node, from the cache of freed Nodes when possible
+ */
+void* Set::Node::operator new(std::size_t size) {
+    set_instrumentation::allocated(size);
+    
+    if constexpr (Set::recycles_nodes) {
+        if (size == sizeof(Node) && node_cache.first != nullptr) {
+            FreeSlot* slot = node_cache.first;
+            node_cache.first = slot->next;
+            --node_cache.size;
+            return slot;
+        }
+    }
+    
+    set_instrumentation::heap_allocated();
+    return ::operator new(size);
+}
+
+/*
+ * Deallocate the memory of a Node, keeping it in the cache of freed Nodes when there is room
+ */
+void Set::Node::operator delete(void* p, std::size_t size) {
+    set_instrumentation::deallocated(size);
+    
+    if constexpr (Set::recycles_nodes) {
+        if (size == sizeof(Node) && !node_cache.closed && node_cache.size < NodeCache::capacity) {
+            static_cast<void>(node_cache_release);  // make sure the cache is released when the thread ends
+            
+            node_cache.first = ::new (p) FreeSlot{node_cache.first};
+            ++node_cache.size;
+            return;
+        }
+    }
+    
+    ::operator delete(p);
+}
+
+/*
+ * Return number of existing nodes
+ * Always 0, if the instrumentation is disabled
  */
 int Set::get_count_nodes() {
-    return Set::Node::count_nodes;
+    return static_cast<int>(set_instrumentation::live_nodes());
+}
+
+/*
+ * Return a snapshot of the instrumentation counters
+ */
+Set::Stats Set::get_stats() {
+    return set_instrumentation::snapshot();
+}
+
+/*
+ * Reset the instrumentation counters, except the number of existing nodes
+ */
+void Set::reset_stats() {
+    set_instrumentation::reset();
 }
 
 /*
@@ -28,15 +368,22 @@ Set::Set() : counter{0} {
 /*
  *  Conversion constructor: convert val into a singleton {val}, O(1)
  */
-Set::Set(int val) : Set{} {  // create an empty list
+Set::Set(value_type val) : Set{} {  // create an empty list
     insert_node(tail,val);
 }
 
 /*
- * Constructor to create a Set from a sorted vector of ints
- * Create a Set with all ints in sorted vector list_of_values, O(n)
+ * Constructor to create a Set from a vector of ints
+ * Create a Set with all ints in vector list_of_values
+ * O(n) if the vector is sorted without repetitions, otherwise O(n log n)
  */
-Set::Set(const std::vector<int>& v) : Set{} {  // create an empty list
+Set::Set(const std::vector<value_type>& v) : Set{} {  // create an empty list
+    // Strictly increasing values can be appended as they are
+    if (std::ranges::adjacent_find(v, std::greater_equal<>{}) != v.end()) {
+        insert(v);
+        return;
+    }
+    
     for (size_t i=0; i < v.size(); i++) {
         insert_node(tail, v[i]);
         
@@ -56,6 +403,25 @@ Set::Set(const Set& S) : Set{} {  // create an empty list, call by refernce
         ptr1 = ptr1->next;
     }
 
+    // The filter and the sketch of S describe the same values, so they are copied instead of rebuilt
+    if (const auto* filter = S.prefilter.get()) {
+        prefilter.set(new set_prefilter::Filter{*filter});
+    }
+    if (const auto* sketch = S.kmv.get()) {
+        kmv.set(new set_sketch::Sketch{*sketch});
+    }
+}
+
+/*
+ * Move constructor: create a new Set that takes over the nodes of Set S, O(1)
+ * \param S Set to be moved, S is left as an empty Set
+ */
+Set::Set(Set&& S) : Set{} {  // create an empty list, to be handed over to S
+    std::swap(head, S.head);
+    std::swap(tail, S.tail);
+    std::swap(counter, S.counter);
+    kmv.swap(S.kmv);
+    prefilter.swap(S.prefilter);
 }
 
 /*
@@ -63,12 +429,7 @@ Set::Set(const Set& S) : Set{} {  // create an empty list, call by refernce
  * Remove all nodes from the list, except the dummy nodes, O(n)
  */
 void Set::make_empty() {
-    Node* dummy = head->next;
-    while (dummy != tail) {
-        remove_node(dummy); // "remove" dummy from first place but move it further down the list
-        dummy = head->next;
-    }
-    
+    remove_nodes_from(head->next);
 }
 
 /*
@@ -95,6 +456,8 @@ Set& Set::operator=(Set S) {
     std::swap(head, S.head);
     std::swap(tail, S.tail);
     std::swap(counter, S.counter);
+    kmv.swap(S.kmv);
+    prefilter.swap(S.prefilter);
     
     return *this;
 }
@@ -104,20 +467,48 @@ Set& Set::operator=(Set S) {
  * Return true if val belongs to the set, otherwise false
  * This function does not modify the Set in any way, O(n)
  */
-bool Set::is_member(int val) const {
-    Node* ptr2 = head->next;
-    while (ptr2 != tail && val != ptr2->value) {
-        ptr2 = ptr2->next;
+bool Set::is_member(value_type val) const {
+    // Values outside [smallest, largest] cannot belong to the Set, O(1)
+    if (is_empty() || val < head->next->value || tail->prev->value < val) {
+        return false;
     }
     
-    if(ptr2 == tail) {
+    // Values rejected by the filter do not belong to the Set, O(1)
+    if (const auto* filter = membership_filter(); filter && !filter->may_contain(set_prefilter::hash(val))) {
         return false;
     }
-    else {
-        return true;
-        
+    
+    // The list is sorted, so the search stops at the first value not less than val
+    Node* ptr2 = find_bound(val, false).first;
+    return ptr2->value == val;
+}
+
+/*
+ * Test whether each value in probes belongs to the Set
+ * The probes are visited in increasing order, sorted ones as they are and others through a sorted index,
+ * so one sweep over the list answers all of them, O(n + m log m) for m probes, O(n + m) if sorted
+ */
+void Set::contains_batch(std::span<const value_type> probes, std::span<bool> out) const {
+    // Only the probes that have an entry in out are answered
+    probes = probes.first(std::min(probes.size(), out.size()));
+    
+    std::vector<std::size_t> order;
+    const bool sorted = std::ranges::is_sorted(probes);
+    if (!sorted) {
+        order.resize(probes.size());
+        std::iota(order.begin(), order.end(), std::size_t{0});
+        std::ranges::sort(order, {}, [probes](std::size_t i) { return probes[i]; });
     }
+    
+    Node* ptr = head->next;
+    for (std::size_t j = 0; j < probes.size(); ++j) {
+        const std::size_t i = sorted ? j : order[j];
         
+        while (ptr != tail && ptr->value < probes[i]) {
+            ptr = ptr->next;
+        }
+        out[i] = (ptr != tail && ptr->value == probes[i]);
+    }
 }
 
 /*
@@ -132,10 +523,12 @@ bool Set::operator==(const Set& S) const {
               return false;
     }
     
+    ScopedOperation op{Operation::comparison};
     Node* ptr1 = head->next; // *this
     Node* ptr2 = S.head->next; // S
     
     while ((ptr1 != tail) && (ptr2 != S.tail)) {
+        op.step();
         if (ptr1->value != ptr2->value){
             return false;
         }
@@ -161,35 +554,41 @@ std::partial_ordering Set::operator<=>(const Set& S) const {
         return std::partial_ordering::equivalent;
     }
     
-    bool subset = true;
+    // Sets of equal cardinality that are not equal cannot contain each other
+    if (counter == S.counter) {
+        return std::partial_ordering::unordered;
+    }
+    
+    ScopedOperation op{Operation::comparison};
     Node* ptr1 = head->next; // *this
     Node* ptr2 = S.head->next; // S
     
-    // Check if *this is a subset of S
-    while ( ptr1 != tail) {
-        
-        // If less = subset, ptr1 cannot be a subset of ptr2.
-        if (ptr2 == S.tail || ptr1->value < ptr2->value) {
-            subset = false;
-            break;
-        }
-        else if (ptr1->value == ptr2->value) {
-            ptr1= ptr1->next;
-            ptr2= ptr2->next;
+    // Only the smaller Set can be contained in the larger one, a single sweep is enough
+    if (counter < S.counter) {
+        // Check if *this is a subset of S
+        while (ptr1 != tail) {
+            op.step();
             
+            // If less = subset, ptr1 cannot be a subset of ptr2.
+            if (ptr2 == S.tail || ptr1->value < ptr2->value) {
+                return std::partial_ordering::unordered;
+            }
+            else if (ptr1->value == ptr2->value) {
+                ptr1= ptr1->next;
+                ptr2= ptr2->next;
+            }
+            else {
+                ptr2 = ptr2->next;
+            }
         }
-        else {
-            ptr2 = ptr2->next;
-        }
-            
+        return std::partial_ordering::less;
     }
     
     // Check if *this is a superset of S
-    bool superset= true;
     while (ptr2 != S.tail) {
+        op.step();
         if (ptr1 == tail || ptr1->value > ptr2->value) {
-            superset = false;
-            break;
+            return std::partial_ordering::unordered;
             
         } else if (ptr1->value == ptr2->value) {
             ptr1= ptr1->next;
@@ -198,21 +597,122 @@ std::partial_ordering Set::operator<=>(const Set& S) const {
         } else {
             ptr1 = ptr1->next;
         }
-        
+    }
+    return std::partial_ordering::greater;
+}
+
+/*
+ * Count the number of values in the intersection of *this and S, without building it
+ * One merge pass and no allocations, O(n)
+ */
+Set::size_type Set::intersection_size(const Set& S) const {
+    if (this == &S) {
+        return counter;
+    }
+    if (disjoint_ranges(S)) {
+        return 0;
     }
     
-    // Check for superset/subset
-   if (subset == true) {
-        return std::partial_ordering::less;
+    ScopedOperation op{Operation::set_intersection};
+    Node* ptr1 = head->next;
+    Node* ptr2 = S.head->next;
+    size_type common = 0;
+    
+    while (ptr1 != tail && ptr2 != S.tail) {
+        op.step();
+        if (ptr1->value < ptr2->value) {
+            ptr1 = ptr1->next;
+        }
+        else if (ptr2->value < ptr1->value) {
+            ptr2 = ptr2->next;
+        }
+        else {
+            ++common;
+            ptr1 = ptr1->next;
+            ptr2 = ptr2->next;
+        }
+    }
+    return common;
+}
+
+/*
+ * Count the number of values in the union of *this and S, without building it, O(n)
+ */
+Set::size_type Set::union_size(const Set& S) const {
+    return counter + S.counter - intersection_size(S);
+}
+
+/*
+ * Count the number of values in the Set difference *this-S, without building it, O(n)
+ */
+Set::size_type Set::difference_size(const Set& S) const {
+    return counter - intersection_size(S);
+}
+
+/*
+ * Jaccard similarity of *this and S, |*this*S| / |*this+S|
+ * Return 1.0, if both Sets are empty, O(n)
+ */
+double Set::jaccard(const Set& S) const {
+    const size_type common = intersection_size(S);
+    const size_type all = counter + S.counter - common;
+    
+    if (all == 0) {
+        return 1.0;
+    }
+    return static_cast<double>(common) / static_cast<double>(all);
+}
+
+/*
+ * Estimate the number of values in the union of *this and S from the sketches of the Sets, O(k)
+ * The estimate is kept between the largest cardinality and the sum of the cardinalities
+ */
+Set::size_type Set::estimate_union_size(const Set& S) const {
+    if constexpr (!set_sketch::enabled) {
+        return union_size(S);
     }
-    else if (superset == true) {
-        return std::partial_ordering::greater;
+    
+    const double estimate = set_sketch::Sketch::merge(*sketch(), *S.sketch()).estimate();
+    return std::clamp(static_cast<size_type>(std::llround(estimate)), std::max(counter, S.counter), counter + S.counter);
+}
+
+/*
+ * Estimate the number of values in the intersection of *this and S from the sketches of the Sets, O(k)
+ * Jaccard similarity times the size of the union, kept below the smallest cardinality
+ */
+Set::size_type Set::estimate_intersection_size(const Set& S) const {
+    if constexpr (!set_sketch::enabled) {
+        return intersection_size(S);
     }
-    else {
-        return std::partial_ordering::unordered;
-            
+    
+    const double estimate = estimate_jaccard(S) * static_cast<double>(estimate_union_size(S));
+    return std::min(static_cast<size_type>(std::llround(estimate)), std::min(counter, S.counter));
+}
+
+/*
+ * Estimate the Jaccard similarity of *this and S from the sketches of the Sets, O(k)
+ * Return 1.0, if both Sets are empty
+ */
+double Set::estimate_jaccard(const Set& S) const {
+    if constexpr (!set_sketch::enabled) {
+        return jaccard(S);
     }
     
+    return set_sketch::Sketch::jaccard(*sketch(), *S.sketch());
+}
+
+/*
+ * Return the sketch of the Set, built if needed
+ * O(1) if the sketch exists, otherwise O(n)
+ */
+const set_sketch::Sketch* Set::sketch() const {
+    return kmv.get_or_build([this] {
+        set_sketch::Sketch sketch;
+        for (Node* p = head->next; p != tail; p = p->next) {
+            sketch.add(set_sketch::hash(p->value));
+        }
+        return sketch;
+    });
 }
     
         
@@ -221,12 +721,18 @@ std::partial_ordering Set::operator<=>(const Set& S) const {
 * Set *this is modified and then returned, O(n)
 */
 Set& Set::operator+=(const Set& S) {
+    // S += S leaves S unchanged, no need to merge the list with itself
+    if (this == &S) {
+        return *this;
+    }
         
+    ScopedOperation op{Operation::set_union};
     Node* ptr1 = head->next;;
     Node* ptr2 = S.head->next;
         
     // Union = combining the elements of two sets
     while (ptr1 != tail && ptr2 != S.tail ) {
+        op.step();
         if (ptr1->value < ptr2->value) {
             ptr1 = ptr1->next;
         }
@@ -242,6 +748,7 @@ Set& Set::operator+=(const Set& S) {
     }
     while (ptr2 != S.tail) {
         // if ptr1 finished -> add the rest of the values in ptr2
+        op.step();
         insert_node(tail,ptr2->value);
         ptr2=ptr2->next;
             
@@ -254,10 +761,23 @@ Set& Set::operator+=(const Set& S) {
      * Set *this is modified and then returned, O(n)
      */
 Set& Set::operator*=(const Set& S) {
+    // S *= S leaves S unchanged
+    if (this == &S) {
+        return *this;
+    }
+    
+    // No common values possible, skip the merge
+    if (disjoint_ranges(S)) {
+        make_empty();
+        return *this;
+    }
+    
+    ScopedOperation op{Operation::set_intersection};
     Node* ptr1 = head->next;
     Node* ptr2 = S.head->next;
         
     while (ptr1 != tail && ptr2 != S.tail) {
+        op.step();
         if (ptr1->value < ptr2->value) {
             ptr1 = ptr1->next;
             remove_node(ptr1->prev); // remove if ptr2 does not exist in ptr1
@@ -271,10 +791,8 @@ Set& Set::operator*=(const Set& S) {
         }
     }
         
-    while (ptr1 != tail) {
-        ptr1 = ptr1->next;
-        remove_node(ptr1->prev);
-    }
+    // Values larger than the largest value in S
+    remove_nodes_from(ptr1);
         
     return *this;
 }
@@ -284,10 +802,23 @@ Set& Set::operator*=(const Set& S) {
 * Set *this is modified and then returned, O(n)
 */
 Set& Set::operator-=(const Set& S) {
+    // S -= S is the empty set
+    if (this == &S) {
+        make_empty();
+        return *this;
+    }
+    
+    // Nothing to remove if S has no values within the range of *this
+    if (disjoint_ranges(S)) {
+        return *this;
+    }
+    
+    ScopedOperation op{Operation::set_difference};
     Node* ptr1 = head->next;
     Node* ptr2 = S.head->next;
         
     while (ptr1 != tail && ptr2 != S.tail) {
+        op.step();
         if (ptr1->value > ptr2->value) {
             ptr2 = ptr2->next;
         }
@@ -303,6 +834,264 @@ Set& Set::operator-=(const Set& S) {
         
     return *this;
 }
+
+/*
+ * Insert val into the Set
+ * Return true if val was inserted, false if val already belonged to the Set
+ * O(1) if val is larger than all values in the Set, otherwise O(n)
+ */
+bool Set::insert(value_type val) {
+    if (is_empty() || tail->prev->value < val) {
+        insert_node(tail, val);
+        return true;
+    }
+    
+    Node* ptr = find_bound(val, false).first;  // not the dummy tail, since val is not larger than all values
+    
+    if (ptr->value == val) {
+        return false;
+    }
+    insert_node(ptr, val);
+    return true;
+}
+
+/*
+ * Insert all ints in values into the Set
+ * values are sorted and repetitions removed, then merged into the list in one pass
+ * Return the number of values that were inserted, O(n + m log m)
+ */
+Set::size_type Set::insert(std::span<const value_type> values) {
+    std::vector<value_type> sorted(values.begin(), values.end());
+    std::ranges::sort(sorted);
+    const auto [first, last] = std::ranges::unique(sorted);
+    sorted.erase(first, last);
+    
+    const size_type old_counter = counter;
+    Node* ptr = head->next;
+    
+    for (value_type val : sorted) {
+        while (ptr != tail && ptr->value < val) {
+            ptr = ptr->next;
+        }
+        if (ptr == tail || ptr->value != val) {
+            insert_node(ptr, val);
+        }
+    }
+    return counter - old_counter;
+}
+
+/*
+ * Remove val from the Set
+ * Return true if val was removed, false if val did not belong to the Set, O(n)
+ */
+bool Set::erase(value_type val) {
+    Node* ptr = find_bound(val, false).first;
+    
+    if (ptr == tail || ptr->value != val) {
+        return false;
+    }
+    remove_node(ptr);
+    return true;
+}
+
+
+/*
+ * Return an iterator to the smallest value in the Set, O(1)
+ */
+Set::const_iterator Set::begin() const {
+    return const_iterator{head->next};
+}
+
+/*
+ * Return an iterator to the position after the largest value in the Set, O(1)
+ */
+Set::const_iterator Set::end() const {
+    return const_iterator{tail};
+}
+
+/*
+ * Return an iterator to the smallest value in the Set that is not less than val
+ * Return end(), if there is no such value, O(min(k, n-k)) where k is the position of the value
+ */
+Set::const_iterator Set::lower_bound(value_type val) const {
+    return const_iterator{find_bound(val, false).first};
+}
+
+/*
+ * Return the number of values in the Set that are less than val, O(min(k, n-k)) where k is the result
+ */
+Set::size_type Set::rank(value_type val) const {
+    return find_bound(val, false).second;
+}
+
+/*
+ * Return an iterator to the k-th smallest value in the Set, counting from 0
+ * The list is walked from the closest end, O(min(k, n-k))
+ */
+Set::const_iterator Set::select(size_type k) const {
+    if (k >= counter) {
+        return end();
+    }
+    
+    Node* ptr;
+    if (k < counter / 2) {
+        ptr = head->next;
+        for (size_type i = 0; i < k; ++i) {
+            ptr = ptr->next;
+        }
+    } else {
+        ptr = tail->prev;
+        for (size_type i = counter - 1; i > k; --i) {
+            ptr = ptr->prev;
+        }
+    }
+    return const_iterator{ptr};
+}
+
+/*
+ * Return the number of values in the Set that belong to [lo, hi]
+ * The two bounds are found from the nearer end of the list, and the count is the difference of their positions,
+ * O(min(a, n-a) + min(b, n-b)) with a values before lo and b values up to hi
+ * The walks may pass values in the range, but never visit more Nodes than there are values outside it
+ */
+Set::size_type Set::count_in_range(value_type lo, value_type hi) const {
+    if (hi < lo) {
+        return 0;
+    }
+    return find_bound(hi, true).second - find_bound(lo, false).second;
+}
+
+/*
+ * Return the union of all Sets pointed by sets
+ * A min-heap holds the current Node of each Set, so the result is built in one merge pass
+ * O(N log k), where N is the total number of values and k the number of Sets
+ */
+Set Set::union_all(std::span<const Set* const> sets) {
+    using Entry = std::pair<value_type, std::size_t>;  // (value, index of its Set in sets)
+    
+    std::vector<Node*> current(sets.size());
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+    
+    for (std::size_t i = 0; i < sets.size(); ++i) {
+        current[i] = sets[i]->head->next;
+        if (current[i] != sets[i]->tail) {
+            heap.emplace(current[i]->value, i);
+        }
+    }
+    
+    ScopedOperation op{Operation::set_union};
+    Set result{};
+    while (!heap.empty()) {
+        op.step();
+        const auto [val, i] = heap.top();
+        heap.pop();
+        
+        // Equal values leave the heap one after the other, keep only the first
+        if (result.is_empty() || result.tail->prev->value != val) {
+            result.insert_node(result.tail, val);
+        }
+        
+        current[i] = current[i]->next;
+        if (current[i] != sets[i]->tail) {
+            heap.emplace(current[i]->value, i);
+        }
+    }
+    return result;
+}
+
+/*
+ * Return the intersection of all Sets pointed by sets
+ * The smallest Set is copied once and then intersected with the others in increasing size,
+ * so the intermediate result only shrinks, O(N)
+ */
+Set Set::intersect_all(std::span<const Set* const> sets) {
+    if (sets.empty()) {
+        return Set{};
+    }
+    
+    std::vector<const Set*> by_size(sets.begin(), sets.end());
+    std::ranges::sort(by_size, {}, &Set::counter);
+    
+    Set result{*by_size.front()};
+    for (std::size_t i = 1; i < by_size.size() && !result.is_empty(); ++i) {
+        result *= *by_size[i];
+    }
+    return result;
+}
+
+/*
+ * Write Set *this to stream os in a compact binary format, O(n)
+ * Layout: magic, number of values, number of blocks,
+ * index of (zigzag first value, size in bytes) per block, then the blocks
+ * A block holds the differences between consecutive values, after its first value
+ */
+void Set::write_binary(std::ostream& os) const {
+    if constexpr (binary_format_supported<value_type>) {
+        write_integers<value_type>(*this, os);
+    } else {
+        os.setstate(std::ios::failbit);
+    }
+}
+
+/*
+ * Read a Set written by write_binary from stream is, O(n)
+ */
+Set Set::read_binary(std::istream& is) {
+    if constexpr (binary_format_supported<value_type>) {
+        return read_integers<value_type>(is, std::numeric_limits<value_type>::min(),
+                                         std::numeric_limits<value_type>::max());
+    } else {
+        is.setstate(std::ios::failbit);
+        return Set{};
+    }
+}
+
+/*
+ * Read only the values in [lo, hi] of a Set written by write_binary from stream is
+ * O(index + values decoded), see read_integers
+ */
+Set Set::read_binary(std::istream& is, value_type lo, value_type hi) {
+    if constexpr (binary_format_supported<value_type>) {
+        return read_integers<value_type>(is, lo, hi);
+    } else {
+        is.setstate(std::ios::failbit);
+        return Set{};
+    }
+}
+
+/*****************************************************
+ * Implementation of Set::const_iterator              *
+ ******************************************************/
+
+Set::const_iterator::reference Set::const_iterator::operator*() const {
+    return current->value;
+}
+
+Set::const_iterator::pointer Set::const_iterator::operator->() const {
+    return &current->value;
+}
+
+Set::const_iterator& Set::const_iterator::operator++() {
+    current = current->next;
+    return *this;
+}
+
+Set::const_iterator Set::const_iterator::operator++(int) {
+    const_iterator old{*this};
+    current = current->next;
+    return old;
+}
+
+Set::const_iterator& Set::const_iterator::operator--() {
+    current = current->prev;
+    return *this;
+}
+
+Set::const_iterator Set::const_iterator::operator--(int) {
+    const_iterator old{*this};
+    current = current->prev;
+    return old;
+}
     
 
     /* ******************************************** *
@@ -314,10 +1103,19 @@ Set& Set::operator-=(const Set& S) {
      * \param p pointer to a Node
      * \param val value to be inserted  after position p, O(1)
      */
-    void Set::insert_node(Node* p, int val) {
+    void Set::insert_node(Node* p, value_type val) {
         Node* newNode = new Node(val, p, p->prev);
         p->prev = p->prev->next = newNode;
         ++counter;
+        
+        if (auto* sketch = kmv.get()) {
+            sketch->add(set_sketch::hash(val));
+        }
+        
+        // The filter keeps up with insertions until it is full
+        if (auto* filter = prefilter.get(); filter && !filter->add(set_prefilter::hash(val))) {
+            prefilter.reset();
+        }
     }
     
     /*
@@ -328,11 +1126,104 @@ Set& Set::operator-=(const Set& S) {
         p->next->prev = p->prev;
         p->prev->next = p->next;
 
+        if (auto* sketch = kmv.get(); sketch && sketch->contains(set_sketch::hash(p->value))) {
+            kmv.reset();
+        }
+        if (auto* filter = prefilter.get(); filter && !filter->remove()) {
+            prefilter.reset();
+        }
         delete p;
         counter--;
         
     }
     
+    /*
+     * Remove the Node pointed by p and all Nodes after it, up to the dummy tail Node
+     * The list is relinked once, instead of once per removed Node
+     * \param p pointer to a Node, O(n)
+     */
+    void Set::remove_nodes_from(Node* p) {
+        Node* last = p->prev;
+        const size_type before = counter;
+        while (p != tail) {
+            Node* next = p->next;
+            if (auto* sketch = kmv.get(); sketch && sketch->contains(set_sketch::hash(p->value))) {
+                kmv.reset();
+            }
+            delete p;
+            --counter;
+            p = next;
+        }
+        
+        last->next = tail;
+        tail->prev = last;
+        if (auto* filter = prefilter.get(); filter && !filter->remove(before - counter)) {
+            prefilter.reset();
+        }
+    }
+    
+    /*
+     * Return the filter of the values used by is_member, built if needed
+     * O(1) if the filter exists, otherwise O(n)
+     */
+    const set_prefilter::Filter* Set::membership_filter() const {
+        return prefilter.get_or_build([this] {
+            set_prefilter::Filter filter{counter};
+            for (Node* p = head->next; p != tail; p = p->next) {
+                filter.add(set_prefilter::hash(p->value));
+            }
+            return filter;
+        });
+    }
+    
+    /*
+     * Find the first Node whose value is not less than val (upper == false)
+     * or greater than val (upper == true), and its position in the list
+     * The list is walked from both ends at the same time,
+     * so finding the Node at position k costs O(min(k, n-k))
+     */
+    std::pair<Set::Node*, Set::size_type> Set::find_bound(value_type val, bool upper) const {
+        // Values before the bound are less than val (or not greater than val, for upper)
+        auto before = [val, upper](const value_type& x) {
+            return upper ? !(val < x) : (x < val);
+        };
+        
+        // The bound is always somewhere in [front, back]
+        Node* front = head->next;
+        Node* back = tail;
+        size_type front_pos = 0;
+        size_type back_pos = counter;
+        
+        while (front != back) {
+            if (!before(front->value)) {
+                return {front, front_pos};
+            }
+            front = front->next;
+            ++front_pos;
+            
+            if (front == back) {
+                break;
+            }
+            if (before(back->prev->value)) {
+                return {back, back_pos};
+            }
+            back = back->prev;
+            --back_pos;
+        }
+        return {back, back_pos};
+    }
+    
+    /*
+     * Test whether the ranges [smallest, largest] of the values in *this and in S do not overlap
+     * The smallest and largest values are next to the dummy nodes, O(1)
+     */
+    bool Set::disjoint_ranges(const Set& S) const {
+        if (is_empty() || S.is_empty()) {
+            return true;
+        }
+        return (tail->prev->value < S.head->next->value) || (S.tail->prev->value < head->next->value);
+    }
+    
     /*
      * Write Set *this to stream os
      */
@@ -2,11 +2,31 @@
 
 #include <iostream>
 #include <vector>
+#include <span>
+#include <iterator>
+#include <cstddef>
+#include <utility>
 #include <compare>  // three-way comparison operator <=>
+#include <type_traits>
+
+#include "instrumentation.h"
+#include "sketch.h"
+#include "prefilter.h"
+#include "lazy_slot.h"
+
+// AddressSanitizer must see every deleted Node to detect uses after free, so the Node cache is then disabled
+#if defined(__SANITIZE_ADDRESS__)
+#define SET_ADDRESS_SANITIZER
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SET_ADDRESS_SANITIZER
+#endif
+#endif
 
 /** Class to represent a Set of ints
  *
  * Set is implemented as a sorted doubly linked list
+ * The type of the stored values is Set::value_type, which any totally ordered type can replace
  * Sets should not contain repetitions, i.e.
  * two ints with the same value cannot belong to a Set
  *
@@ -15,6 +35,12 @@
 class Set {
 
 public:
+    using value_type = int;  // type of the values stored in the Set
+    using size_type = std::size_t;
+
+    class const_iterator;  // nested class defined after class Set
+    using iterator = const_iterator;
+    
     /*
      *  Default constructor :create an empty Set
      */
@@ -23,13 +49,14 @@ public:
     /*
      *  Conversion constructor: convert val into a singleton {val}
      */
-    Set(int val);
+    Set(value_type val);
 
     /*
-     * Constructor to create a Set from a sorted vector of ints
-     * Create a Set with all ints in sorted vector list_of_values
+     * Constructor to create a Set from a vector of ints
+     * Create a Set with all ints in vector list_of_values
+     * list_of_values may be unsorted and contain repetitions
      */
-    explicit Set(const std::vector<int>& list_of_values);
+    explicit Set(const std::vector<value_type>& list_of_values);
 
     /*
      * Copy constructor: create a new Set as a copy of Set S
@@ -38,6 +65,13 @@ public:
      */
     Set(const Set& S);
 
+    /*
+     * Move constructor: create a new Set that takes over the nodes of Set S, O(1)
+     * \param S Set to be moved, S becomes an empty Set
+     * Not noexcept: S gets new dummy Nodes, whose allocation may throw std::bad_alloc
+     */
+    Set(Set&& S);
+
     /*
      * Transform the Set into an empty set
      * Remove all nodes from the list, except the dummy nodes
@@ -52,16 +86,26 @@ public:
     /*
      * Assignment operator: assign new contents to the *this Set, replacing its current content
      * \param S Set to be copied into Set *this
-     * Call by valued is used
+     * Call by valued is used, so an rvalue argument is moved instead of copied
      */
     Set& operator=(Set S);
 
     /*
      * Test whether val belongs to the Set
      * Return true if val belongs to the set, otherwise false
+     * Built with SET_PREFILTER, most values that do not belong to the Set are rejected by a filter, see prefilter.h
+     * This function does not modify the values of the Set in any way
+     */
+    bool is_member(value_type val) const;
+
+    /*
+     * Test whether each value in probes belongs to the Set
+     * out[i] is set to is_member(probes[i]), for the first min(probes.size(), out.size()) probes
+     * The other entries of out are left unchanged
+     * probes may be unsorted, all of them are answered in one sweep over the list
      * This function does not modify the Set in any way
      */
-    bool is_member(int val) const;
+    void contains_batch(std::span<const value_type> probes, std::span<bool> out) const;
 
     /*
      * Test whether the Set is empty
@@ -77,7 +121,7 @@ public:
      * Return number of elements in the set
      * This function does not modify the Set in any way
      */
-    size_t cardinality() const {
+    size_type cardinality() const {
         return counter;
     }
 
@@ -97,6 +141,58 @@ public:
      */
     std::partial_ordering operator<=>(const Set& S) const;
 
+    /*
+     * Count the number of values in the intersection of *this and S, without building it
+     * This function does not modify the Sets in any way
+     */
+    size_type intersection_size(const Set& S) const;
+
+    /*
+     * Count the number of values in the union of *this and S, without building it
+     * This function does not modify the Sets in any way
+     */
+    size_type union_size(const Set& S) const;
+
+    /*
+     * Count the number of values in the Set difference *this-S, without building it
+     * This function does not modify the Sets in any way
+     */
+    size_type difference_size(const Set& S) const;
+
+    /*
+     * Jaccard similarity of *this and S: size of the intersection divided by size of the union
+     * Return 1.0, if both Sets are empty
+     * This function does not modify the Sets in any way
+     */
+    double jaccard(const Set& S) const;
+
+    /*
+     * Estimate the number of values in the union of *this and S from the sketches of the Sets
+     * Exact if the union has fewer than set_sketch::k values, or if built without SET_SKETCH
+     * This function does not modify the Sets in any way
+     */
+    size_type estimate_union_size(const Set& S) const;
+
+    /*
+     * Estimate the number of values in the intersection of *this and S from the sketches of the Sets
+     * Exact if the union has fewer than set_sketch::k values, or if built without SET_SKETCH
+     * This function does not modify the Sets in any way
+     */
+    size_type estimate_intersection_size(const Set& S) const;
+
+    /*
+     * Estimate the Jaccard similarity of *this and S from the sketches of the Sets
+     * Exact if the union has fewer than set_sketch::k values, or if built without SET_SKETCH
+     * This function does not modify the Sets in any way
+     */
+    double estimate_jaccard(const Set& S) const;
+
+    /*
+     * Return the sketch of the Set, to be merged with set_sketch::Sketch::merge, built if needed
+     * Return nullptr, if the project is built without SET_SKETCH
+     */
+    const set_sketch::Sketch* sketch() const;
+
     /*
      * Modify Set *this such that it becomes the union of *this with Set S
      * Set *this is modified and then returned
@@ -115,18 +211,138 @@ public:
      */
     Set& operator-=(const Set& S);
 
+    /*
+     * Insert val into the Set
+     * Return true if val was inserted, false if val already belonged to the Set
+     */
+    bool insert(value_type val);
+
+    /*
+     * Insert all ints in values into the Set
+     * values may be unsorted and contain repetitions
+     * Return the number of values that were inserted
+     */
+    size_type insert(std::span<const value_type> values);
+
+    /*
+     * Remove val from the Set
+     * Return true if val was removed, false if val did not belong to the Set
+     */
+    bool erase(value_type val);
+
+    /*
+     * Return an iterator to the smallest value in the Set
+     * The values are visited in increasing order
+     */
+    const_iterator begin() const;
+
+    /*
+     * Return an iterator to the position after the largest value in the Set
+     */
+    const_iterator end() const;
+
+    /*
+     * Return an iterator to the smallest value in the Set that is not less than val
+     * Return end(), if there is no such value
+     */
+    const_iterator lower_bound(value_type val) const;
+
+    /*
+     * Return the number of values in the Set that are less than val
+     */
+    size_type rank(value_type val) const;
+
+    /*
+     * Return an iterator to the k-th smallest value in the Set, counting from 0
+     * Return end(), if k >= cardinality()
+     */
+    const_iterator select(size_type k) const;
+
+    /*
+     * Return the number of values in the Set that belong to [lo, hi]
+     */
+    size_type count_in_range(value_type lo, value_type hi) const;
+
+    /*
+     * Return the union of all Sets pointed by sets, in one k-way merge pass
+     * Return an empty Set, if sets is empty
+     */
+    static Set union_all(std::span<const Set* const> sets);
+
+    /*
+     * Return the intersection of all Sets pointed by sets
+     * The Sets are intersected from the smallest to the largest one
+     * Return an empty Set, if sets is empty
+     */
+    static Set intersect_all(std::span<const Set* const> sets);
+
+    /*
+     * Write Set *this to stream os in a compact binary format
+     * Values are stored in blocks of 128, as varint encoded deltas,
+     * after an index with the first value and the size in bytes of each block
+     * os should be opened in binary mode
+     * The format holds integers of at most 64 bits, for any other value_type nothing is written
+     * and the failbit of os is set
+     */
+    void write_binary(std::ostream& os) const;
+
+    /*
+     * Read a Set written by write_binary from stream is
+     * Set the failbit of is and return the values read so far, if the data is not a valid Set:
+     * values that do not fit in value_type or do not increase, or sizes that do not match the data
+     */
+    static Set read_binary(std::istream& is);
+
+    /*
+     * Read only the values in [lo, hi] of a Set written by write_binary from stream is
+     * Blocks that cannot contain values in [lo, hi] are skipped without being decoded
+     * Set the failbit of is and return the values read so far, if the data is not a valid Set
+     */
+    static Set read_binary(std::istream& is, value_type lo, value_type hi);
+
+    /*
+     * true if the memory of deleted Nodes is reused by new Nodes, see node.h
+     * Requires SET_NODE_CACHE (CMake option, ON by default), and a build without AddressSanitizer
+     */
+#if defined(SET_NODE_CACHE) && !defined(SET_ADDRESS_SANITIZER)
+    static constexpr bool recycles_nodes = true;
+#else
+    static constexpr bool recycles_nodes = false;
+#endif
+
     /*
      * Return number of existing nodes
-     * Used solely for debug purposes
+     * Used solely for debug purposes, requires SET_INSTRUMENTATION
      */
     static int get_count_nodes();
 
+    using Stats = set_instrumentation::Stats;
+
+    /*
+     * Return the number of nodes, allocations, and the work done by each kind of Set operation
+     * All counters are zero, if the project is built without SET_INSTRUMENTATION
+     */
+    static Stats get_stats();
+
+    /*
+     * Reset the counters of allocations and Set operations, and restart the peak number of nodes
+     */
+    static void reset_stats();
+
 private:
     class Node;  // nested class defined in node.h
 
     Node* head;      // pointer to the dummy header Node
     Node* tail;      // pointer to the dummy tail Node
-    size_t counter;  // number of values in the Set
+    size_type counter;  // number of values in the Set
+
+    using SketchSlot = std::conditional_t<set_sketch::enabled, LazySlot<set_sketch::Sketch>,
+                                          NoSlot<set_sketch::Sketch>>;
+    [[no_unique_address]] SketchSlot kmv;  // sketch of the values for the estimates, built on first use
+
+    using PrefilterSlot = std::conditional_t<set_prefilter::enabled, LazySlot<set_prefilter::Filter>,
+                                             NoSlot<set_prefilter::Filter>>;
+    [[no_unique_address]] PrefilterSlot prefilter;  // filter for is_member, built on first use
 
     /* ************************** *
      * Private Member Functions    *
@@ -137,7 +353,7 @@ private:
      * \param p pointer to a Node
      * \param val value to be inserted  after position p
      */
-    void insert_node(Node* p, int val);
+    void insert_node(Node* p, value_type val);
 
     /*
      * Remove the Node pointed by p
@@ -145,6 +361,31 @@ private:
      */
     void remove_node(Node* p);
 
+    /*
+     * Remove the Node pointed by p and all Nodes after it, except the dummy tail Node
+     * \param p pointer to a Node
+     */
+    void remove_nodes_from(Node* p);
+
+    /*
+     * Return the filter of the values used by is_member, built if needed
+     * Return nullptr, if the project is built without SET_PREFILTER
+     */
+    const set_prefilter::Filter* membership_filter() const;
+
+    /*
+     * Test whether the ranges [smallest, largest] of the values in *this and in S do not overlap
+     * Return true if the Sets cannot have a common element, otherwise false
+     */
+    bool disjoint_ranges(const Set& S) const;
+
+    /*
+     * Find the first Node whose value is not less than val (upper == false)
+     * or greater than val (upper == true), and its position in the list
+     * Return the dummy tail Node and cardinality(), if there is no such Node
+     */
+    std::pair<Node*, size_type> find_bound(value_type val, bool upper) const;
+
     /*
      * Write Set *this to stream os
      */
@@ -169,7 +410,8 @@ private:
      * Return a new Set representing the union of S1 with S2, S1+S2
      */
     friend Set operator+(Set S1, const Set& S2) {
-        return (S1 += S2);
+        S1 += S2;
+        return S1;  // S1 is moved, not copied
     }
 
     /*
@@ -178,7 +420,8 @@ private:
      * Return a new Set representing the intersection of S1 with S2, S1*S2
      */
     friend Set operator*(Set S1, const Set& S2) {
-        return (S1 *= S2);
+        S1 *= S2;
+        return S1;
     }
 
     /*
@@ -187,6 +430,43 @@ private:
      * Return a new Set representing the set difference S1-S2
      */
     friend Set operator-(Set S1, const Set& S2) {
-        return (S1 -= S2);
+        S1 -= S2;
+        return S1;
     }
+};
+
+/** Class Set::const_iterator
+ *
+ * Bidirectional iterator to the values of a Set, in increasing order
+ * Values cannot be modified through the iterator, since that could break the order of the list
+ * An iterator is invalidated when the Node it refers to is removed from the Set
+ */
+class Set::const_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Set::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    const_iterator() = default;
+
+    reference operator*() const;
+    pointer operator->() const;
+
+    const_iterator& operator++();
+    const_iterator operator++(int);
+
+    const_iterator& operator--();
+    const_iterator operator--(int);
+
+    bool operator==(const const_iterator& it) const = default;
+
+private:
+    friend class Set;
+
+    explicit const_iterator(const Node* p) : current{p} {
+    }
+
+    const Node* current = nullptr;  // Node storing the value, or the dummy tail Node for end()
 };
\ No newline at end of file
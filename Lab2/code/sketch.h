@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/** Cardinality sketch of class Set
+ *
+ * Built with SET_SKETCH defined (CMake option SET_SKETCH, ON by default),
+ * a Set can keep a K-minimum-values (KMV) sketch of its values: the k smallest hashes of the values
+ * Sketches of two Sets are merged into the sketch of their union, and give estimates of the sizes
+ * of the union and the intersection, and of the Jaccard similarity, in O(k) without reading the values
+ * While a Set has fewer than k values its sketch holds all of them, and the estimates are exact
+ *
+ * The sketch is allocated and built, in O(n), the first time an estimate asks for it,
+ * so a Set that is never estimated only pays for one pointer
+ * Once built, inserting a value updates the sketch in O(k)
+ * Removing a value that is in the sketch drops the sketch until the next estimate
+ *
+ * Built without SET_SKETCH, a Set never builds a sketch and computes its estimates exactly instead
+ */
+namespace set_sketch {
+
+inline constexpr std::size_t k = 64;  // number of hashes kept by a sketch
+
+/*
+ * Hash of val, mixed with the finalizer of splitmix64 so that close values get unrelated hashes
+ */
+template <typename T>
+std::uint64_t hash(const T& val) {
+    std::uint64_t h = std::hash<T>{}(val);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+#ifdef SET_SKETCH
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+class Sketch {
+public:
+    /*
+     * Add hash h, O(k)
+     */
+    void add(std::uint64_t h) {
+        if (count == k && h >= hashes[k - 1]) {
+            return;
+        }
+
+        auto pos = std::lower_bound(hashes.begin(), hashes.begin() + count, h);
+        if (pos != hashes.begin() + count && *pos == h) {
+            return;
+        }
+        if (count < k) {
+            ++count;
+        }
+        std::move_backward(pos, hashes.begin() + count - 1, hashes.begin() + count);
+        *pos = h;
+    }
+
+    /*
+     * Test whether h is one of the hashes of the sketch, O(log k)
+     * A removed value with such a hash leaves the sketch out of date
+     */
+    bool contains(std::uint64_t h) const {
+        return std::binary_search(hashes.begin(), hashes.begin() + count, h);
+    }
+
+    /*
+     * Sketch of the union of the Sets sketched by a and b, O(k)
+     */
+    static Sketch merge(const Sketch& a, const Sketch& b) {
+        Sketch result;
+        std::size_t i = 0;
+        std::size_t j = 0;
+
+        while (result.count < k && (i < a.count || j < b.count)) {
+            std::uint64_t h;
+            if (j == b.count || (i < a.count && a.hashes[i] < b.hashes[j])) {
+                h = a.hashes[i++];
+            } else if (i == a.count || b.hashes[j] < a.hashes[i]) {
+                h = b.hashes[j++];
+            } else {
+                h = a.hashes[i++];
+                ++j;
+            }
+            result.hashes[result.count++] = h;
+        }
+        return result;
+    }
+
+    /*
+     * Estimate of the number of values sketched, O(1)
+     * Exact if there are fewer than k values
+     */
+    double estimate() const {
+        if (count < k) {
+            return static_cast<double>(count);
+        }
+        // The k-th smallest of n uniform hashes in [0, 1) is about k / n
+        const double kth = (static_cast<double>(hashes[k - 1]) + 1.0) / 18446744073709551616.0;  // 2^64
+        return static_cast<double>(k - 1) / kth;
+    }
+
+    /*
+     * Estimate of the Jaccard similarity of the Sets sketched by a and b, O(k)
+     * The fraction of the k smallest hashes of the union that are in both Sets
+     * Return 1.0, if both Sets are empty
+     */
+    static double jaccard(const Sketch& a, const Sketch& b) {
+        const Sketch all = merge(a, b);
+        if (all.count == 0) {
+            return 1.0;
+        }
+
+        // A hash among the k smallest of the union that belongs to a Set is among the k smallest of that Set
+        std::size_t common = 0;
+        for (std::size_t i = 0; i < all.count; ++i) {
+            common += a.contains(all.hashes[i]) && b.contains(all.hashes[i]);
+        }
+        return static_cast<double>(common) / static_cast<double>(all.count);
+    }
+
+private:
+    std::array<std::uint64_t, k> hashes{};  // the count smallest hashes, in increasing order
+    std::size_t count = 0;
+};
+
+}  // namespace set_sketch